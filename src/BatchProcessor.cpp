@@ -0,0 +1,117 @@
+/* 
+ * BatchProcessor Class
+ *  - The MPO files are processed by the pipeline in the batch.
+ *  - The stages of the pipeline run on the frames at the same time,
+ *    then the next frame is decoded while the frame is matched
+ *    and the previous frame is meshed.
+ *  - Each stage processes the frames one by one in order,
+ *    and the frames are passed between the stages by the bounded queues.
+ *  - The stage waits while the queue to the next stage is full,
+ *    then the number of the frames in memory is bounded.
+ * 
+ * File:   BatchProcessor.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#include "BatchProcessor.h"
+#include "Parallel.h"
+
+const size_t BatchProcessor::QUEUESIZE = 2;
+
+/**
+ * Constructor and Destructor
+ * @param pipeline
+ * @param number of the frames in the queue between the stages
+ * @param number of the threads, or 0 for the number of the cores
+ */
+BatchProcessor::BatchProcessor(const Pipeline& pipe, size_t queueSize, unsigned int nThreads)
+: pipe(pipe), queueSize(queueSize > 0 ? queueSize : 1)
+, pool(nThreads > 0 ? nThreads : Parallel::nThreads()) {
+    stgs = this->pipe.order();
+    running.assign(stgs.size(), false);
+}
+
+BatchProcessor::~BatchProcessor() {
+}
+
+/**
+ * Process the MPO files
+ * The function is called for each frame in order on the calling thread,
+ * and the error of the frame is set to the frame instead of throwing.
+ * @param file names
+ * @param function called for each processed frame
+ */
+void BatchProcessor::run(const vector<string>& fns, const function<void(Pipeline::Frame&)>& done) {
+    if (fns.empty()) {
+        return;
+    }
+    // the file names are queued at once, and the frames are bounded after the first stage
+    queues.clear();
+    queues.push_back(unique_ptr<FrameQueue>(new FrameQueue(fns.size())));
+    for (size_t i = 0; i < stgs.size(); i++) {
+        queues.push_back(unique_ptr<FrameQueue>(new FrameQueue(queueSize)));
+    }
+    for (size_t i = 0; i < fns.size(); i++) {
+        shared_ptr<Pipeline::Frame> frm(new Pipeline::Frame);
+        frm->fn = fns[i];
+        frm->index = i;
+        queues[0]->push(frm);
+    }
+    schedule();
+    for (size_t i = 0; i < fns.size(); i++) {
+        shared_ptr<Pipeline::Frame> frm;
+        queues.back()->pop(frm);
+        // the room of the output queue is made
+        schedule();
+        done(*frm);
+    }
+    pool.wait();
+}
+
+/**
+ * Start the stages that have the frame to process
+ * The stage is not started while the queue to the next stage is full.
+ * The later stage is started first to make the room for the earlier stage.
+ */
+void BatchProcessor::schedule() {
+    lock_guard<mutex> lock(mtx);
+    for (size_t i = stgs.size(); i-- > 0; ) {
+        if (running[i] || queues[i+1]->isFull()) {
+            continue;
+        }
+        shared_ptr<Pipeline::Frame> frm;
+        if (!queues[i]->tryPop(frm)) {
+            continue;
+        }
+        running[i] = true;
+        pool.submit([this, i, frm]() { runStage(i, frm); });
+    }
+}
+
+/**
+ * Run the stage for the frame
+ * The failed frame skips the rest of the stages.
+ * @param index of the stage
+ * @param frame
+ */
+void BatchProcessor::runStage(size_t stg, const shared_ptr<Pipeline::Frame>& frm) {
+    if (frm->error.empty()) {
+        try {
+            Pipeline::runStage(*stgs[stg], *frm);
+        } catch (const string& msg) {
+            frm->error = msg;
+        } catch (const exception& ex) {
+            frm->error = ex.what();
+        }
+    }
+    // the queue has the room, because only this stage pushes to it
+    queues[stg+1]->push(frm);
+    {
+        lock_guard<mutex> lock(mtx);
+        running[stg] = false;
+    }
+    schedule();
+}
+
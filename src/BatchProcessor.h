@@ -0,0 +1,55 @@
+/* 
+ * BatchProcessor Class
+ *  - The MPO files are processed by the pipeline in the batch.
+ *  - The stages of the pipeline run on the frames at the same time,
+ *    then the next frame is decoded while the frame is matched
+ *    and the previous frame is meshed.
+ *  - Each stage processes the frames one by one in order,
+ *    and the frames are passed between the stages by the bounded queues.
+ *  - The stage waits while the queue to the next stage is full,
+ *    then the number of the frames in memory is bounded.
+ * 
+ * File:   BatchProcessor.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#ifndef BATCHPROCESSOR_H
+#define	BATCHPROCESSOR_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Pipeline.h"
+#include "BoundedQueue.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+class BatchProcessor {
+public:
+    // default number of the frames in the queue between the stages
+    static const size_t QUEUESIZE;
+    BatchProcessor(const Pipeline& pipe, size_t queueSize = QUEUESIZE, unsigned int nThreads = 0);
+    virtual ~BatchProcessor();
+    void run(const vector<string>& fns, const function<void(Pipeline::Frame&)>& done);
+private:
+    typedef BoundedQueue<shared_ptr<Pipeline::Frame>> FrameQueue;
+    void schedule();
+    void runStage(size_t stg, const shared_ptr<Pipeline::Frame>& frm);
+    Pipeline pipe;                          // pipeline
+    vector<const Pipeline::Stage*> stgs;    // stages in the order to run
+    size_t queueSize;                       // number of the frames in the queue
+    // input queues of the stages, and the output queue of the last stage
+    vector<unique_ptr<FrameQueue>> queues;
+    vector<bool> running;   // the stage is running or not
+    mutex mtx;              // mutex of the scheduling
+    ThreadPool pool;        // thread pool to run the stages
+
+};
+
+#endif	/* BATCHPROCESSOR_H */
+
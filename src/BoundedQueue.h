@@ -0,0 +1,119 @@
+/* 
+ * BoundedQueue Class
+ *  - The thread safe FIFO queue whose capacity is bounded.
+ *  - The producer is blocked while the queue is full,
+ *    and the consumer is blocked while the queue is empty.
+ *  - The closed queue releases the blocked producers and consumers.
+ * 
+ * File:   BoundedQueue.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#ifndef BOUNDEDQUEUE_H
+#define	BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+template <typename T>
+class BoundedQueue {
+public:
+    /**
+     * Constructor and Destructor
+     * @param maximum number of the items
+     */
+    BoundedQueue(size_t capacity) : cap(capacity > 0 ? capacity : 1), closed(false) {
+    };
+    virtual ~BoundedQueue() {
+    };
+    // get the maximum number of the items
+    size_t capacity() const { return cap; };
+    /**
+     * Get the number of the items
+     * @return number of the items
+     */
+    size_t size() const {
+        lock_guard<mutex> lock(mtx);
+        return items.size();
+    };
+    /**
+     * Verify whether the queue is full
+     * @return full or not
+     */
+    bool isFull() const {
+        lock_guard<mutex> lock(mtx);
+        return (items.size() >= cap);
+    };
+    /**
+     * Push the item, and wait while the queue is full
+     * @param item
+     * @return pushed, or false if the queue is closed
+     */
+    bool push(const T& item) {
+        unique_lock<mutex> lock(mtx);
+        notFull.wait(lock, [&]() { return (closed || items.size() < cap); });
+        if (closed) {
+            return false;
+        }
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    };
+    /**
+     * Pop the item, and wait while the queue is empty
+     * @param popped item
+     * @return popped, or false if the queue is closed and empty
+     */
+    bool pop(T& item) {
+        unique_lock<mutex> lock(mtx);
+        notEmpty.wait(lock, [&]() { return (closed || !items.empty()); });
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    };
+    /**
+     * Pop the item without waiting
+     * @param popped item
+     * @return popped, or false if the queue is empty
+     */
+    bool tryPop(T& item) {
+        lock_guard<mutex> lock(mtx);
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    };
+    /**
+     * Close the queue
+     * The items in the queue can be popped yet.
+     */
+    void close() {
+        lock_guard<mutex> lock(mtx);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    };
+private:
+    mutable mutex mtx;              // mutex of the items
+    condition_variable notFull;     // condition that the queue is not full
+    condition_variable notEmpty;    // condition that the queue is not empty
+    deque<T> items;                 // items
+    size_t cap;                     // maximum number of the items
+    bool closed;                    // the queue is closed or not
+
+};
+
+#endif	/* BOUNDEDQUEUE_H */
+
@@ -0,0 +1,160 @@
+/* 
+ * CalibrationStore Class
+ *  - The calibrated stereo cameras are stored as the profiles
+ *    keyed by the maker and the model of the camera in EXIF.
+ *  - The profiles are read and written in the binary file.
+ *  - The profile of the camera is found by the model of the MPO file,
+ *    and the default profile is used if no profile is for the model.
+ *  - The camera parameters in YAML are imported as the default profile
+ *    if the binary file does not exist.
+ *  - The store is shared by the threads.
+ * 
+ * File:   CalibrationStore.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:30 PM
+ */
+
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include "CalibrationStore.h"
+#include "StereoCamera.h"
+
+const string CalibrationStore::STOREFILENAME("calibration.bin");
+const string CalibrationStore::DEFAULTMODEL("");
+const char CalibrationStore::SIGNATURE[] = { 'R', 'P', '3', 'C' };
+const uint32_t CalibrationStore::VERSION = 1;
+
+/**
+ * Constructor and Destructor
+ * @param file name of the profiles
+ */
+CalibrationStore::CalibrationStore(const string& fn) : fn(fn) {
+}
+
+CalibrationStore::~CalibrationStore() {
+}
+
+/**
+ * Open the profiles
+ * The file consists of the signature, the version, the number of the profiles,
+ * and the model and the camera parameters of each profile.
+ * @return read or not
+ */
+bool CalibrationStore::open() {
+    map<string, shared_ptr<StereoCamera>> cams;
+    ifstream file(fn.c_str(), ios::in | ios::binary);
+    if (!file) {
+        // import the camera parameters in YAML
+        shared_ptr<StereoCamera> sCam(new StereoCamera);
+        if (!sCam->open() || !sCam->isValid()) {
+            return false;
+        }
+        cams[DEFAULTMODEL] = sCam;
+    } else {
+        char sig[sizeof(SIGNATURE)];
+        uint32_t ver = 0, nCams = 0;
+        file.read(sig, sizeof(sig));
+        file.read((char*)&ver, sizeof(ver));
+        file.read((char*)&nCams, sizeof(nCams));
+        if (!file || strncmp(sig, SIGNATURE, sizeof(SIGNATURE)) != 0 || ver != VERSION) {
+            throw string("Invalid calibration file ") + fn;
+        }
+        for (uint32_t i = 0; i < nCams; i++) {
+            uint32_t len = 0;
+            if (!file.read((char*)&len, sizeof(len)) || len > 0xffff) {
+                throw string("Invalid calibration file ") + fn;
+            }
+            string model(len, '\0');
+            if (!file.read(&model[0], len)) {
+                throw string("Invalid calibration file ") + fn;
+            }
+            shared_ptr<StereoCamera> sCam(new StereoCamera);
+            sCam->read(file);
+            cams[model] = sCam;
+        }
+    }
+    lock_guard<mutex> lock(mtx);
+    this->cams.swap(cams);
+    return true;
+}
+
+/**
+ * Save the profiles
+ */
+void CalibrationStore::save() const {
+    lock_guard<mutex> lock(mtx);
+    ofstream file(fn.c_str(), ios::out | ios::binary | ios::trunc);
+    uint32_t nCams = cams.size();
+    file.write(SIGNATURE, sizeof(SIGNATURE));
+    file.write((const char*)&VERSION, sizeof(VERSION));
+    file.write((const char*)&nCams, sizeof(nCams));
+    for_each(cams.begin(), cams.end(), [&](const pair<const string, shared_ptr<StereoCamera>>& cam) {
+        uint32_t len = cam.first.size();
+        file.write((const char*)&len, sizeof(len));
+        file.write(cam.first.data(), len);
+        cam.second->write(file);
+    });
+    if (!file) {
+        throw string("Could not write ") + fn;
+    }
+}
+
+/**
+ * Get the models of the profiles
+ * @return models
+ */
+vector<string> CalibrationStore::models() const {
+    lock_guard<mutex> lock(mtx);
+    vector<string> mdls;
+    for_each(cams.begin(), cams.end(), [&](const pair<const string, shared_ptr<StereoCamera>>& cam) {
+        mdls.push_back(cam.first);
+    });
+    return mdls;
+}
+
+/**
+ * Find the profile of the camera
+ * The copy of the stereo camera is returned,
+ * and it shares the rectification maps with the profile.
+ * @param maker and model of the camera
+ * @return stereo camera of the model or of the default profile, or null if not found
+ */
+shared_ptr<StereoCamera> CalibrationStore::find(const string& model) const {
+    lock_guard<mutex> lock(mtx);
+    auto it = cams.find(model);
+    if (it == cams.end()) {
+        it = cams.find(DEFAULTMODEL);
+    }
+    if (it == cams.end()) {
+        return nullptr;
+    }
+    return shared_ptr<StereoCamera>(new StereoCamera(*it->second));
+}
+
+/**
+ * Insert the profile of the camera
+ * The profile of the same model is replaced.
+ * The first profile is also used as the default profile.
+ * @param maker and model of the camera
+ * @param stereo camera
+ */
+void CalibrationStore::insert(const string& model, const StereoCamera& sCam) {
+    lock_guard<mutex> lock(mtx);
+    shared_ptr<StereoCamera> cam(new StereoCamera(sCam));
+    cams[model] = cam;
+    if (cams.find(DEFAULTMODEL) == cams.end()) {
+        cams[DEFAULTMODEL] = cam;
+    }
+}
+
+/**
+ * Remove the profile of the camera
+ * @param maker and model of the camera
+ */
+void CalibrationStore::remove(const string& model) {
+    lock_guard<mutex> lock(mtx);
+    cams.erase(model);
+}
+
@@ -0,0 +1,57 @@
+/* 
+ * CalibrationStore Class
+ *  - The calibrated stereo cameras are stored as the profiles
+ *    keyed by the maker and the model of the camera in EXIF.
+ *  - The profiles are read and written in the binary file.
+ *  - The profile of the camera is found by the model of the MPO file,
+ *    and the default profile is used if no profile is for the model.
+ *  - The camera parameters in YAML are imported as the default profile
+ *    if the binary file does not exist.
+ *  - The store is shared by the threads.
+ * 
+ * File:   CalibrationStore.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:30 PM
+ */
+
+#ifndef CALIBRATIONSTORE_H
+#define	CALIBRATIONSTORE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class StereoCamera;
+
+class CalibrationStore {
+public:
+    // file name of the profiles
+    static const string STOREFILENAME;
+    // model of the default profile
+    static const string DEFAULTMODEL;
+    CalibrationStore(const string& fn = STOREFILENAME);
+    virtual ~CalibrationStore();
+    bool open();
+    void save() const;
+    vector<string> models() const;
+    shared_ptr<StereoCamera> find(const string& model) const;
+    void insert(const string& model, const StereoCamera& sCam);
+    void remove(const string& model);
+private:
+    // signature and version of the file
+    static const char SIGNATURE[];
+    static const uint32_t VERSION;
+    string fn;                                  // file name
+    mutable mutex mtx;                          // mutex of the profiles
+    map<string, shared_ptr<StereoCamera>> cams; // stereo cameras by the models
+
+};
+
+#endif	/* CALIBRATIONSTORE_H */
+
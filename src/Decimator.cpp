@@ -0,0 +1,404 @@
+/* 
+ * Decimator Class
+ *  - The triangle mesh is simplified by the quadric error metric.
+ *  - The edges are collapsed in the order of the cost by using the heap.
+ *  - The vertex is collapsed into the one of its neighbors,
+ *    then the simplified meshes share the vertices of the original mesh.
+ *  - The meshes are extracted at the target numbers of the triangles
+ *    as the levels of detail.
+ * 
+ * File:   Decimator.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include "Decimator.h"
+
+const double Decimator::BOUNDARYWEIGHT = 100.0;
+const double Decimator::MINOFCOSINE = 0.2;
+
+/**
+ * Constructor and Destructor
+ * @param positions of the vertices, 3 values per vertex
+ * @param vertex indexes of the triangles, 3 indexes per triangle
+ */
+Decimator::Decimator(const vector<float>& pos, const vector<uint32_t>& idxs)
+: pos(pos), faces(idxs.begin(), idxs.begin() + idxs.size() / 3 * 3), nFaces(idxs.size() / 3) {
+    const uint32_t nVtcs = pos.size() / 3;
+    // list the faces around the vertex
+    vtxFaceOfs.assign(nVtcs + 1, 0);
+    for_each(idxs.begin(), idxs.begin() + nFaces * 3, [&](uint32_t vtx) {
+        vtxFaceOfs[vtx+1]++;
+    });
+    for (uint32_t i = 0; i < nVtcs; i++) {
+        vtxFaceOfs[i+1] += vtxFaceOfs[i];
+    }
+    vtxFaces.resize(nFaces * 3);
+    vector<uint32_t> fill(vtxFaceOfs.begin(), vtxFaceOfs.end() - 1);
+    for (size_t i = 0; i < nFaces * 3; i++) {
+        vtxFaces[fill[idxs[i]]++] = i / 3;
+    }
+    mergedFaces.resize(nVtcs);
+    merged.assign(nVtcs, 0);
+    removed.assign(nVtcs, 0);
+    stamp.assign(nVtcs, 0);
+    // find the boundary edges, which are used by only one triangle
+    vector<uint64_t> edges;
+    edges.reserve(nFaces * 3);
+    for (size_t i = 0; i < nFaces * 3; i += 3) {
+        for (int j = 0; j < 3; j++) {
+            uint64_t a = idxs[i+j];
+            uint64_t b = idxs[i+(j+1)%3];
+            edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+        }
+    }
+    sort(edges.begin(), edges.end());
+    auto isBoundary = [&](uint64_t a, uint64_t b) {
+        uint64_t key = (a < b ? (a << 32 | b) : (b << 32 | a));
+        auto it = lower_bound(edges.begin(), edges.end(), key);
+        return (it + 1 == edges.end() || *(it + 1) != key);
+    };
+    // accumulate the quadrics of the planes of the triangles
+    // and of the planes that are perpendicular to the boundary edges
+    quadrics.resize(nVtcs);
+    for (size_t i = 0; i < nFaces * 3; i += 3) {
+        const float* p[] = { position(idxs[i]), position(idxs[i+1]), position(idxs[i+2]) };
+        double e1[3], e2[3], n[3];
+        for (int j = 0; j < 3; j++) {
+            e1[j] = p[1][j] - p[0][j];
+            e2[j] = p[2][j] - p[0][j];
+        }
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len == 0.0) {
+            continue;
+        }
+        for (int j = 0; j < 3; j++) {
+            n[j] /= len;
+        }
+        Quadric q(n, -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]), len / 2.0);
+        for (int j = 0; j < 3; j++) {
+            quadrics[idxs[i+j]] += q;
+        }
+        for (int j = 0; j < 3; j++) {
+            uint32_t a = idxs[i+j];
+            uint32_t b = idxs[i+(j+1)%3];
+            if (!isBoundary(a, b)) {
+                continue;
+            }
+            const float* pa = position(a);
+            const float* pb = position(b);
+            double e[] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            double m[] = { e[1] * n[2] - e[2] * n[1],
+                           e[2] * n[0] - e[0] * n[2],
+                           e[0] * n[1] - e[1] * n[0] };
+            double mLen = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+            if (mLen == 0.0) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                m[k] /= mLen;
+            }
+            Quadric bq(m, -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]), BOUNDARYWEIGHT * mLen);
+            quadrics[a] += bq;
+            quadrics[b] += bq;
+        }
+    }
+    // push the candidates, each edge is pushed once by the sorted keys
+    // regardless of the winding of the triangles
+    heap.reserve(nFaces * 2);
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (i > 0 && edges[i] == edges[i-1]) {
+            continue;
+        }
+        uint32_t a = (uint32_t)(edges[i] >> 32);
+        uint32_t b = (uint32_t)(edges[i] & 0xffffffff);
+        if (a != b) {
+            pushCollapse(a, b);
+        }
+    }
+}
+
+Decimator::~Decimator() {
+}
+
+/**
+ * Simplify the mesh
+ * @param target numbers of the triangles
+ * @return vertex indexes of the triangles at each target in the descending order,
+ *         the last mesh is shared by the rest of the targets that could not be reached
+ */
+vector<shared_ptr<vector<uint32_t>>> Decimator::decimate(vector<size_t> nTargets) {
+    sort(nTargets.begin(), nTargets.end(), greater<size_t>());
+    vector<shared_ptr<vector<uint32_t>>> lods;
+    auto target = nTargets.begin();
+    while (target != nTargets.end()) {
+        if (nFaces <= *target) {
+            lods.push_back(extract());
+            ++target;
+            continue;
+        }
+        if (heap.empty()) {
+            // the mesh could not be simplified any more
+            shared_ptr<vector<uint32_t>> lod = extract();
+            for (; target != nTargets.end(); ++target) {
+                lods.push_back(lod);
+            }
+            break;
+        }
+        pop_heap(heap.begin(), heap.end());
+        Collapse c = heap.back();
+        heap.pop_back();
+        // skip the candidate that is outdated by the other collapses
+        if (removed[c.from] || removed[c.to] ||
+            stamp[c.from] != c.fromStamp || stamp[c.to] != c.toStamp) {
+            continue;
+        }
+        if (isCollapsible(c.from, c.to)) {
+            collapse(c.from, c.to);
+        }
+    }
+    return lods;
+}
+
+/**
+ * Call the function for each remaining triangle around the vertex
+ * @param remaining vertex
+ * @param function called with the vertices of the triangle
+ */
+template<typename F>
+void Decimator::forEachFace(uint32_t vtx, F fn) const {
+    const uint32_t* begin = vtxFaces.data() + vtxFaceOfs[vtx];
+    const uint32_t* end = vtxFaces.data() + vtxFaceOfs[vtx+1];
+    if (merged[vtx]) {
+        begin = mergedFaces[vtx].data();
+        end = begin + mergedFaces[vtx].size();
+    }
+    for (const uint32_t* face = begin; face != end; ++face) {
+        uint32_t a = faces[*face*3];
+        uint32_t b = faces[*face*3+1];
+        uint32_t c = faces[*face*3+2];
+        if (a != b && b != c && c != a) {
+            fn(*face, a, b, c);
+        }
+    }
+}
+
+/**
+ * Verify whether the collapse keeps the topology and the orientation of the triangles
+ * The neighbors shared by the vertices must be the opposite vertices
+ * of the triangles on the edge, otherwise the mesh becomes non-manifold.
+ * @param vertex to be removed
+ * @param vertex to be kept
+ * @return collapsible or not
+ */
+bool Decimator::isCollapsible(uint32_t from, uint32_t to) {
+    // verify the link condition
+    vector<uint32_t> fromNbrs, toNbrs, opposites;
+    forEachFace(from, [&](uint32_t face, uint32_t a, uint32_t b, uint32_t c) {
+        const uint32_t vtcs[] = { a, b, c };
+        bool onEdge = (a == to || b == to || c == to);
+        for (int j = 0; j < 3; j++) {
+            if (vtcs[j] != from && vtcs[j] != to) {
+                fromNbrs.push_back(vtcs[j]);
+                if (onEdge) {
+                    opposites.push_back(vtcs[j]);
+                }
+            }
+        }
+    });
+    forEachFace(to, [&](uint32_t face, uint32_t a, uint32_t b, uint32_t c) {
+        const uint32_t vtcs[] = { a, b, c };
+        for (int j = 0; j < 3; j++) {
+            if (vtcs[j] != from && vtcs[j] != to) {
+                toNbrs.push_back(vtcs[j]);
+            }
+        }
+    });
+    for (vector<uint32_t>* vtcs : { &fromNbrs, &toNbrs, &opposites }) {
+        sort(vtcs->begin(), vtcs->end());
+        vtcs->erase(unique(vtcs->begin(), vtcs->end()), vtcs->end());
+    }
+    vector<uint32_t> shared;
+    set_intersection(fromNbrs.begin(), fromNbrs.end(), toNbrs.begin(), toNbrs.end(), back_inserter(shared));
+    if (shared != opposites) {
+        return false;
+    }
+    // verify the orientation
+    bool valid = true;
+    const float* pTo = position(to);
+    forEachFace(from, [&](uint32_t face, uint32_t a, uint32_t b, uint32_t c) {
+        if (!valid || a == to || b == to || c == to) {
+            return;
+        }
+        const uint32_t vtcs[] = { a, b, c };
+        const float* p[3];
+        const float* q[3];
+        for (int j = 0; j < 3; j++) {
+            p[j] = position(vtcs[j]);
+            q[j] = (vtcs[j] == from ? pTo : p[j]);
+        }
+        double n0[3], n1[3];
+        for (int j = 0; j < 3; j++) {
+            int k = (j + 1) % 3, l = (j + 2) % 3;
+            n0[j] = (p[1][k] - p[0][k]) * (p[2][l] - p[0][l]) - (p[1][l] - p[0][l]) * (p[2][k] - p[0][k]);
+            n1[j] = (q[1][k] - q[0][k]) * (q[2][l] - q[0][l]) - (q[1][l] - q[0][l]) * (q[2][k] - q[0][k]);
+        }
+        double dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+        double len0 = sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+        double len1 = sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+        if (len1 == 0.0 || dot < MINOFCOSINE * len0 * len1) {
+            valid = false;
+        }
+    });
+    return valid;
+}
+
+/**
+ * Collapse the vertex into its neighbor
+ * @param vertex to be removed
+ * @param vertex to be kept
+ */
+void Decimator::collapse(uint32_t from, uint32_t to) {
+    // move the triangles to the kept vertex,
+    // the triangles that share the edge are degenerated and removed
+    vector<uint32_t> moved;
+    forEachFace(from, [&](uint32_t face, uint32_t a, uint32_t b, uint32_t c) {
+        if (a == to || b == to || c == to) {
+            nFaces--;
+        } else {
+            moved.push_back(face);
+        }
+        for (int j = 0; j < 3; j++) {
+            if (faces[face*3+j] == from) {
+                faces[face*3+j] = to;
+            }
+        }
+    });
+    vector<uint32_t> kept;
+    vector<uint32_t> nbrs;
+    forEachFace(to, [&](uint32_t face, uint32_t a, uint32_t b, uint32_t c) {
+        kept.push_back(face);
+        nbrs.push_back(a);
+        nbrs.push_back(b);
+        nbrs.push_back(c);
+    });
+    for_each(moved.begin(), moved.end(), [&](uint32_t face) {
+        kept.push_back(face);
+        for (int j = 0; j < 3; j++) {
+            nbrs.push_back(faces[face*3+j]);
+        }
+    });
+    mergedFaces[to].swap(kept);
+    merged[to] = 1;
+    vector<uint32_t>().swap(mergedFaces[from]);
+    merged[from] = 1;
+    removed[from] = 1;
+    quadrics[to] += quadrics[from];
+    stamp[from]++;
+    stamp[to]++;
+    // update the candidates around the kept vertex
+    sort(nbrs.begin(), nbrs.end());
+    nbrs.erase(unique(nbrs.begin(), nbrs.end()), nbrs.end());
+    for_each(nbrs.begin(), nbrs.end(), [&](uint32_t nbr) {
+        if (nbr != to) {
+            pushCollapse(to, nbr);
+        }
+    });
+}
+
+/**
+ * Push the cheaper direction to collapse the edge
+ * @param vertex of the edge
+ * @param the other vertex of the edge
+ */
+void Decimator::pushCollapse(uint32_t vtx0, uint32_t vtx1) {
+    Quadric q = quadrics[vtx0];
+    q += quadrics[vtx1];
+    double cost0 = q.error(position(vtx1));    // vtx0 is collapsed into vtx1
+    double cost1 = q.error(position(vtx0));    // vtx1 is collapsed into vtx0
+    Collapse c;
+    if (cost0 <= cost1) {
+        c.cost = (float)cost0;
+        c.from = vtx0;
+        c.to = vtx1;
+    } else {
+        c.cost = (float)cost1;
+        c.from = vtx1;
+        c.to = vtx0;
+    }
+    c.fromStamp = stamp[c.from];
+    c.toStamp = stamp[c.to];
+    heap.push_back(c);
+    push_heap(heap.begin(), heap.end());
+}
+
+/**
+ * Extract the remaining triangles
+ * @return vertex indexes of the triangles
+ */
+shared_ptr<vector<uint32_t>> Decimator::extract() {
+    shared_ptr<vector<uint32_t>> lod(new vector<uint32_t>);
+    lod->reserve(nFaces * 3);
+    for (size_t i = 0; i < faces.size(); i += 3) {
+        uint32_t a = faces[i];
+        uint32_t b = faces[i+1];
+        uint32_t c = faces[i+2];
+        if (a != b && b != c && c != a) {
+            lod->push_back(a);
+            lod->push_back(b);
+            lod->push_back(c);
+        }
+    }
+    return lod;
+}
+
+/**
+ * Constructors of the quadric
+ * @param unit normal vector of the plane
+ * @param distance of the plane from the origin
+ * @param weight
+ */
+Decimator::Quadric::Quadric() {
+    fill_n(a, 10, 0.0);
+}
+
+Decimator::Quadric::Quadric(const double* n, double d, double w) {
+    a[0] = w * n[0] * n[0]; a[1] = w * n[0] * n[1]; a[2] = w * n[0] * n[2];
+    a[3] = w * n[1] * n[1]; a[4] = w * n[1] * n[2]; a[5] = w * n[2] * n[2];
+    a[6] = w * n[0] * d;    a[7] = w * n[1] * d;    a[8] = w * n[2] * d;
+    a[9] = w * d * d;
+}
+
+/**
+ * Add the quadric
+ * @param quadric
+ * @return this quadric
+ */
+Decimator::Quadric& Decimator::Quadric::operator+=(const Quadric& q) {
+    for (int i = 0; i < 10; i++) {
+        a[i] += q.a[i];
+    }
+    return *this;
+}
+
+/**
+ * Get the squared distance from the planes
+ * @param position
+ * @return error
+ */
+double Decimator::Quadric::error(const float* p) const {
+    double x = p[0], y = p[1], z = p[2];
+    double e = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z
+             + a[3] * y * y + 2.0 * a[4] * y * z + a[5] * z * z
+             + 2.0 * (a[6] * x + a[7] * y + a[8] * z) + a[9];
+    return (e > 0.0 ? e : 0.0);
+}
+
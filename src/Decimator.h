@@ -0,0 +1,73 @@
+/* 
+ * Decimator Class
+ *  - The triangle mesh is simplified by the quadric error metric.
+ *  - The edges are collapsed in the order of the cost by using the heap.
+ *  - The vertex is collapsed into the one of its neighbors,
+ *    then the simplified meshes share the vertices of the original mesh.
+ *  - The meshes are extracted at the target numbers of the triangles
+ *    as the levels of detail.
+ * 
+ * File:   Decimator.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#ifndef DECIMATOR_H
+#define	DECIMATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+typedef unsigned char uchar;
+
+using namespace std;
+
+class Decimator {
+public:
+    Decimator(const vector<float>& pos, const vector<uint32_t>& idxs);
+    virtual ~Decimator();
+    vector<shared_ptr<vector<uint32_t>>> decimate(vector<size_t> nTargets);
+private:
+    // the weight of the plane that constrains the boundary edge
+    static const double BOUNDARYWEIGHT;
+    // the minimum cosine between the normal vectors before and after the collapse
+    static const double MINOFCOSINE;
+    // the symmetric 4x4 matrix of the quadric error metric
+    struct Quadric {
+        double a[10];
+        Quadric();
+        Quadric(const double* n, double d, double w);
+        Quadric& operator+=(const Quadric& q);
+        double error(const float* p) const;
+    };
+    // the candidate to collapse the vertex "from" into the vertex "to"
+    struct Collapse {
+        float cost;
+        uint32_t from, to;
+        uint32_t fromStamp, toStamp;
+        bool operator<(const Collapse& c) const { return cost > c.cost; };
+    };
+    template<typename F> void forEachFace(uint32_t vtx, F fn) const;
+    bool isCollapsible(uint32_t from, uint32_t to);
+    void collapse(uint32_t from, uint32_t to);
+    void pushCollapse(uint32_t vtx0, uint32_t vtx1);
+    shared_ptr<vector<uint32_t>> extract();
+    const float* position(uint32_t vtx) const { return &pos[vtx*3]; };
+    const vector<float>& pos;           // positions of the vertices
+    vector<uint32_t> faces;             // vertex indexes of the triangles
+    vector<uint32_t> vtxFaceOfs;        // offsets of the faces around the original vertex
+    vector<uint32_t> vtxFaces;          // faces around the original vertex
+    vector<vector<uint32_t>> mergedFaces;   // faces around the vertex that is updated
+    vector<uchar> merged;               // the faces are in mergedFaces or not
+    vector<uchar> removed;              // the vertex is collapsed or not
+    vector<uint32_t> stamp;             // number of the changes around the vertex
+    vector<Quadric> quadrics;           // quadric error metric of the vertex
+    vector<Collapse> heap;              // candidates to collapse
+    size_t nFaces;                      // number of the remaining triangles
+
+};
+
+#endif	/* DECIMATOR_H */
+
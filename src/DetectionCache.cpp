@@ -0,0 +1,112 @@
+/* 
+ * DetectionCache Class
+ *  - The corners or the centers of the calibration rig pattern
+ *    that are detected in the MPO file are cached.
+ *  - The detection is keyed by the hash of the contents of the file
+ *    and the settings of the calibration rig,
+ *    then the file is not decoded nor detected again when it is not changed.
+ *  - The downscaled left image with the detected pattern is cached for the view.
+ *  - The cache is shared by the threads.
+ * 
+ * File:   DetectionCache.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:00 PM
+ */
+
+#include "DetectionCache.h"
+
+const int DetectionCache::THUMBNAILWIDTH = 640;
+
+/**
+ * Constructor and Destructor
+ */
+DetectionCache::DetectionCache() {
+}
+
+DetectionCache::~DetectionCache() {
+}
+
+/**
+ * Calculate the key of the detection
+ * The contents of the file and the settings are hashed by 64 bit FNV-1a.
+ * @param contents of the MPO file
+ * @param type of the calibration rig pattern
+ * @param number of rows on the calibration rig pattern
+ * @param number of columns on the calibration rig pattern
+ * @return key
+ */
+uint64_t DetectionCache::key(const vector<uchar>& data, RigDialog::Pattern ptn, int rows, int cols) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&](const uchar* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ p[i]) * 1099511628211ULL;
+        }
+    };
+    int settings[] = { (int)ptn, rows, cols };
+    mix((const uchar*)settings, sizeof(settings));
+    if (!data.empty()) {
+        mix(&data[0], data.size());
+    }
+    return hash;
+}
+
+/**
+ * Downscale the image to be cached
+ * @param image
+ * @return image whose width is THUMBNAILWIDTH or less
+ */
+Image DetectionCache::thumbnail(const Image& img) {
+    if (img.isEmpty() || img.width() <= THUMBNAILWIDTH) {
+        return img;
+    }
+    cv::Mat small;
+    double scl = (double)THUMBNAILWIDTH / (double)img.width();
+    cv::resize(img.image(), small, cv::Size(), scl, scl, cv::INTER_AREA);
+    return Image(small);
+}
+
+/**
+ * Find the detection
+ * @param key
+ * @param detection that is found
+ * @return found or not
+ */
+bool DetectionCache::find(uint64_t key, Entry& entry) const {
+    lock_guard<mutex> lock(mtx);
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+/**
+ * Insert the detection
+ * The detection of the same key is replaced.
+ * @param key
+ * @param detection
+ */
+void DetectionCache::insert(uint64_t key, const Entry& entry) {
+    lock_guard<mutex> lock(mtx);
+    entries[key] = entry;
+}
+
+/**
+ * Clear the detections
+ */
+void DetectionCache::clear() {
+    lock_guard<mutex> lock(mtx);
+    entries.clear();
+}
+
+/**
+ * Get the number of the detections
+ * @return number of the detections
+ */
+size_t DetectionCache::size() const {
+    lock_guard<mutex> lock(mtx);
+    return entries.size();
+}
+
@@ -0,0 +1,55 @@
+/* 
+ * DetectionCache Class
+ *  - The corners or the centers of the calibration rig pattern
+ *    that are detected in the MPO file are cached.
+ *  - The detection is keyed by the hash of the contents of the file
+ *    and the settings of the calibration rig,
+ *    then the file is not decoded nor detected again when it is not changed.
+ *  - The downscaled left image with the detected pattern is cached for the view.
+ *  - The cache is shared by the threads.
+ * 
+ * File:   DetectionCache.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:00 PM
+ */
+
+#ifndef DETECTIONCACHE_H
+#define	DETECTIONCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "RigDialog.h"
+#include "Image.h"
+
+using namespace std;
+
+class DetectionCache {
+public:
+    // the detection of the MPO file
+    struct Entry {
+        vector<cv::Point2f> centers[2]; // corners or centers in the left and the right images
+        cv::Size size;                  // size of the images
+        Image thumbnail;                // downscaled left image with the detected pattern
+    };
+    // maximum width of the cached image
+    static const int THUMBNAILWIDTH;
+    DetectionCache();
+    virtual ~DetectionCache();
+    static uint64_t key(const vector<uchar>& data, RigDialog::Pattern ptn, int rows, int cols);
+    static Image thumbnail(const Image& img);
+    bool find(uint64_t key, Entry& entry) const;
+    void insert(uint64_t key, const Entry& entry);
+    void clear();
+    size_t size() const;
+private:
+    mutable mutex mtx;              // mutex of the entries
+    map<uint64_t, Entry> entries;   // detections by the keys
+
+};
+
+#endif	/* DETECTIONCACHE_H */
+
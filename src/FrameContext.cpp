@@ -0,0 +1,231 @@
+/* 
+ * FrameContext Class
+ *  - The buffers of the intermediate data of the frame are pooled,
+ *    and reused by the stages of the pipeline for the next frames.
+ *  - The matrix is keyed by the name, and it is reallocated
+ *    only when the size or the type is changed.
+ *  - The vectors and the point clouds keep their capacity when they are cleared.
+ *  - The polygon mesh objects are reused. The search trees are recreated
+ *    when the context is released, then the pooled context does not keep
+ *    the point cloud of the released frame and its search index.
+ *  - The allocations outside the pool, such as of the results kept by the polygon,
+ *    are counted separately.
+ *  - The contexts are recycled when the frames are released,
+ *    then the frames of the same size are processed without the allocation.
+ * 
+ * File:   FrameContext.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:00 PM
+ */
+
+#include <algorithm>
+#include "FrameContext.h"
+
+const size_t FrameContext::MAXPOOLED = 8;
+mutex FrameContext::poolMtx;
+vector<FrameContext*> FrameContext::pool;
+atomic<size_t> FrameContext::nAllocs(0);
+atomic<size_t> FrameContext::nUnpooled(0);
+
+/**
+ * Constructor and Destructor
+ */
+FrameContext::FrameContext()
+: xyzrgb(new pcl::PointCloud<pcl::PointXYZRGB>), nmls(new pcl::PointCloud<pcl::Normal>), idxs(new vector<int>)
+, xyzrgbTree(new pcl::search::KdTree<pcl::PointXYZRGB>)
+, nmlTree(new pcl::search::KdTree<pcl::PointXYZRGBNormal>), plyMesh(new pcl::PolygonMesh) {
+}
+
+FrameContext::~FrameContext() {
+}
+
+/**
+ * Acquire the context from the pool
+ * The context is returned to the pool when it is released.
+ * @return context
+ */
+shared_ptr<FrameContext> FrameContext::acquire() {
+    FrameContext* ctx = nullptr;
+    {
+        lock_guard<mutex> lock(poolMtx);
+        if (!pool.empty()) {
+            ctx = pool.back();
+            pool.pop_back();
+        }
+    }
+    if (!ctx) {
+        ctx = new FrameContext;
+    }
+    return shared_ptr<FrameContext>(ctx, &FrameContext::release);
+}
+
+/**
+ * Return the context to the pool
+ * The context is deleted if the pool is full.
+ * @param context
+ */
+void FrameContext::release(FrameContext* ctx) {
+    ctx->countAllocations();
+    lock_guard<mutex> lock(poolMtx);
+    if (pool.size() < MAXPOOLED) {
+        // the trees refer to the clouds of the polygon, which may be dropped
+        ctx->xyzrgbTree.reset(new pcl::search::KdTree<pcl::PointXYZRGB>);
+        ctx->nmlTree.reset(new pcl::search::KdTree<pcl::PointXYZRGBNormal>);
+        pool.push_back(ctx);
+    } else {
+        delete ctx;
+    }
+}
+
+/**
+ * Get the number of the allocations of the buffers
+ * The buffer is counted when its address is changed by the frame.
+ * @return number of the allocations
+ */
+size_t FrameContext::nAllocations() {
+    return nAllocs;
+}
+
+/**
+ * Count the allocations outside the pool
+ * @param number of the allocations
+ */
+void FrameContext::countUnpooled(size_t n) {
+    nUnpooled += n;
+}
+
+/**
+ * Get the number of the allocations outside the pool
+ * @return number of the allocations
+ */
+size_t FrameContext::nUnpooledAllocations() {
+    return nUnpooled;
+}
+
+/**
+ * Count the buffers that are allocated by the frame
+ */
+void FrameContext::countAllocations() {
+    size_t n = 0;
+    auto count = [&](const void* buf, const void* data) {
+        if (data && lastData[buf] != data) {
+            lastData[buf] = data;
+            n++;
+        }
+    };
+    for_each(mats.begin(), mats.end(), [&](const pair<const string, cv::Mat>& mat) {
+        count(&mat.second, mat.second.datastart);
+    });
+    for_each(byteBufs.begin(), byteBufs.end(), [&](const pair<const string, vector<uchar>>& buf) {
+        count(&buf.second, buf.second.data());
+    });
+    for_each(floatBufs.begin(), floatBufs.end(), [&](const pair<const string, vector<float>>& buf) {
+        count(&buf.second, buf.second.data());
+    });
+    count(&vtcs, vtcs.data());
+    count(idxs.get(), idxs->data());
+    count(&plyMesh->polygons, plyMesh->polygons.data());
+    count(xyzrgb.get(), xyzrgb->points.data());
+    count(nmls.get(), nmls->points.data());
+    nAllocs += n;
+}
+
+/**
+ * Get the matrix
+ * The matrix is reused by create of OpenCV,
+ * which does not reallocate if the size and the type are not changed.
+ * @param name of the matrix
+ * @return matrix
+ */
+cv::Mat& FrameContext::mat(const string& name) {
+    return mats[name];
+}
+
+/**
+ * Get the byte buffer
+ * @param name of the buffer
+ * @return buffer
+ */
+vector<uchar>& FrameContext::bytes(const string& name) {
+    return byteBufs[name];
+}
+
+/**
+ * Get the float buffer
+ * @param name of the buffer
+ * @return buffer
+ */
+vector<float>& FrameContext::floats(const string& name) {
+    return floatBufs[name];
+}
+
+/**
+ * Get the vertices
+ * The vertices are cleared, and their capacity is kept.
+ * @return vertices
+ */
+vector<Vertex>& FrameContext::vertices() {
+    vtcs.clear();
+    return vtcs;
+}
+
+/**
+ * Get the point cloud
+ * The point cloud is cleared, and its capacity is kept.
+ * @return point cloud
+ */
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr FrameContext::cloud() {
+    xyzrgb->clear();
+    return xyzrgb;
+}
+
+/**
+ * Get the normal vectors
+ * The normal vectors are cleared, and their capacity is kept.
+ * @return normal vectors
+ */
+pcl::PointCloud<pcl::Normal>::Ptr FrameContext::normals() {
+    nmls->clear();
+    return nmls;
+}
+
+/**
+ * Get the point indexes
+ * The indexes are cleared, and their capacity is kept.
+ * @return point indexes
+ */
+pcl::IndicesPtr FrameContext::indices() {
+    idxs->clear();
+    return idxs;
+}
+
+/**
+ * Get the search tree of the point cloud
+ * The tree is kept until the context is released.
+ * @return search tree
+ */
+pcl::search::KdTree<pcl::PointXYZRGB>::Ptr FrameContext::tree() {
+    return xyzrgbTree;
+}
+
+/**
+ * Get the search tree of the point cloud with the normal vectors
+ * The tree is kept until the context is released.
+ * @return search tree
+ */
+pcl::search::KdTree<pcl::PointXYZRGBNormal>::Ptr FrameContext::normalTree() {
+    return nmlTree;
+}
+
+/**
+ * Get the polygon mesh
+ * The polygons and the cloud of the mesh are cleared, and their capacity is kept.
+ * @return polygon mesh
+ */
+pcl::PolygonMesh::Ptr FrameContext::mesh() {
+    plyMesh->polygons.clear();
+    plyMesh->cloud.data.clear();
+    return plyMesh;
+}
+
@@ -0,0 +1,84 @@
+/* 
+ * FrameContext Class
+ *  - The buffers of the intermediate data of the frame are pooled,
+ *    and reused by the stages of the pipeline for the next frames.
+ *  - The matrix is keyed by the name, and it is reallocated
+ *    only when the size or the type is changed.
+ *  - The vectors and the point clouds keep their capacity when they are cleared.
+ *  - The polygon mesh objects are reused. The search trees are recreated
+ *    when the context is released, then the pooled context does not keep
+ *    the point cloud of the released frame and its search index.
+ *  - The allocations outside the pool, such as of the results kept by the polygon,
+ *    are counted separately.
+ *  - The contexts are recycled when the frames are released,
+ *    then the frames of the same size are processed without the allocation.
+ * 
+ * File:   FrameContext.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:00 PM
+ */
+
+#ifndef FRAMECONTEXT_H
+#define	FRAMECONTEXT_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <pcl-1.7/pcl/point_types.h>
+#include <pcl-1.7/pcl/point_cloud.h>
+#include <pcl-1.7/pcl/PolygonMesh.h>
+#include <pcl-1.7/pcl/search/kdtree.h>
+#include "Vertex.h"
+
+using namespace std;
+
+class FrameContext {
+public:
+    // maximum number of the contexts kept in the pool
+    static const size_t MAXPOOLED;
+    static shared_ptr<FrameContext> acquire();
+    static size_t nAllocations();
+    static void countUnpooled(size_t n = 1);
+    static size_t nUnpooledAllocations();
+    virtual ~FrameContext();
+    cv::Mat& mat(const string& name);
+    vector<uchar>& bytes(const string& name);
+    vector<float>& floats(const string& name);
+    vector<Vertex>& vertices();
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud();
+    pcl::PointCloud<pcl::Normal>::Ptr normals();
+    pcl::IndicesPtr indices();
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr tree();
+    pcl::search::KdTree<pcl::PointXYZRGBNormal>::Ptr normalTree();
+    pcl::PolygonMesh::Ptr mesh();
+private:
+    FrameContext();
+    FrameContext(const FrameContext& orig);
+    static void release(FrameContext* ctx);
+    void countAllocations();
+    static mutex poolMtx;                   // mutex of the pool
+    static vector<FrameContext*> pool;      // contexts to be reused
+    static atomic<size_t> nAllocs;          // number of the allocations of the buffers
+    static atomic<size_t> nUnpooled;        // number of the allocations outside the pool
+    map<string, cv::Mat> mats;              // matrices by the names
+    map<string, vector<uchar>> byteBufs;    // byte buffers by the names
+    map<string, vector<float>> floatBufs;   // float buffers by the names
+    vector<Vertex> vtcs;                    // vertices
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr xyzrgb;  // point cloud
+    pcl::PointCloud<pcl::Normal>::Ptr nmls;         // normal vectors
+    pcl::IndicesPtr idxs;                           // point indexes
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr xyzrgbTree;          // search tree of the point cloud
+    pcl::search::KdTree<pcl::PointXYZRGBNormal>::Ptr nmlTree;       // search tree of the point cloud with the normal vectors
+    pcl::PolygonMesh::Ptr plyMesh;                  // polygon mesh
+    // addresses of the buffers when the context is released last
+    map<const void*, const void*> lastData;
+
+};
+
+#endif	/* FRAMECONTEXT_H */
+
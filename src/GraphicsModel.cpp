@@ -3,6 +3,16 @@
  *  - The model of the model/view architecture is implemented.
  *  - Subject class is inherited.
  *  - The Image, StereoCamera and Polygon objects are instantiated.
+ *  - The 3D polygon is constructed by the stages of the pipeline,
+ *    and the observers are notified as each stage of the construction is completed.
+ *  - The observers are notified of which of the image, the calibration,
+ *    the point cloud and the polygon mesh are changed.
+ *  - The 3D polygon is constructed and the stereo camera is calibrated
+ *    by the background worker, and the results are notified on the main thread.
+ *  - The detections of the calibration rig pattern are cached by the files,
+ *    then only the added files are detected when the stereo camera is calibrated again.
+ *  - The stereo camera is selected from the calibration store
+ *    by the camera model of the MPO file.
  * 
  * File:   GraphicsModel.cpp
  * Author: munehiro
@@ -10,45 +20,188 @@
  * Created on February 28, 2014, 6:32 PM
  */
 
+#include <exception>
 #include "GraphicsModel.h"
 #include "Mpo.h"
 #include "Image.h"
 #include "StereoCamera.h"
 #include "Polygon.h"
 #include "Vertex.h"
+#include "Pipeline.h"
+#include "MemoryStats.h"
 
 /**
  * Constructor and Destructor
  */
-GraphicsModel::GraphicsModel() {
-    sCam.reset(new StereoCamera);
-    if (!sCam->open()) {
-        sCam.reset();
+GraphicsModel::GraphicsModel() : stg(Stage::Complete) {
+    store.reset(new CalibrationStore);
+    try {
+        store->open();
+    } catch (const string& msg) {
+        // the stereo camera is not calibrated
     }
 }
 
 GraphicsModel::~GraphicsModel() {
 }
 
+/**
+ * Notify the stage to the observers
+ * @param stage
+ * @param mask of the changes
+ */
+void GraphicsModel::notify(Stage stg, unsigned int changes) {
+    this->stg = stg;
+    Subject::notify(changes);
+}
+
+/**
+ * Publish the result of the stage to the observers on the main thread
+ * The job waits until the observers are notified.
+ * @param job, or null on the main thread
+ * @param stage
+ * @param mask of the changes
+ * @param progress from 0 to 1
+ * @param description of the progress
+ * @param function to set the result to the model
+ */
+void GraphicsModel::publish(Worker::Job* job, Stage stg, unsigned int changes, double progress, const string& desc,
+        const function<void()>& set) {
+    auto fn = [=]() {
+        set();
+        notify(stg, changes);
+        progressSig.emit(progress, desc);
+    };
+    if (job) {
+        job->invoke(fn);
+    } else {
+        fn();
+    }
+}
+
+/**
+ * Report the progress on the main thread
+ * @param job, or null on the main thread
+ * @param progress from 0 to 1
+ * @param description of the progress
+ */
+void GraphicsModel::progress(Worker::Job* job, double progress, const string& desc) {
+    if (job) {
+        job->invoke([=]() { progressSig.emit(progress, desc); });
+    } else {
+        progressSig.emit(progress, desc);
+    }
+}
+
+/**
+ * Report the error of the job on the main thread
+ * The cancelled job is not reported.
+ * @param job
+ * @param error message
+ */
+void GraphicsModel::fail(Worker::Job& job, const string& msg) {
+    if (msg != Worker::CANCELLED) {
+        job.invoke([=]() {
+            progressSig.emit(0.0, msg);
+            errorSig.emit(msg);
+        });
+    }
+}
+
 /**
  * Open the MPO file
+ * The observers are notified once of all the changes when the polygon is constructed.
  * @param file name
  */
 void GraphicsModel::open(const string& fn) {
-    this->img.reset();
-    ply.reset();
-    Mpo mpo;
-    vector<Image> img = mpo.open(fn);
-    if (img.size() != 2) {
-        throw string("Number of image must be 2");
+    beginUpdate();
+    try {
+        construct(fn, nullptr);
+    } catch (...) {
+        endUpdate();
+        throw;
     }
-    // construct the 3D polygon, if the stereo camera is calibrated
-    if (sCam && sCam->isValid()) {
-        ply.reset(new Polygon);
-        ply->setVertices(sCam->reprojectImageTo3D(img));
+    endUpdate();
+}
+
+/**
+ * Open the MPO file by the background worker
+ * The job in progress is cancelled, and the error is reported by the error signal.
+ * @param file name
+ */
+void GraphicsModel::openAsync(const string& fn) {
+    worker.start([=](Worker::Job& job) {
+        try {
+            construct(fn, &job);
+        } catch (const string& msg) {
+            fail(job, msg);
+        } catch (const exception& ex) {
+            fail(job, ex.what());
+        }
+    });
+}
+
+/**
+ * Construct the 3D polygon from the MPO file
+ * The stages of the pipeline are run, and the results are published
+ * after the decode, the rectify, the disparity, the filter and the last stages.
+ * The model is changed only on the main thread when the result is published.
+ * The stereo camera is the copy of the profile for the camera model of the file.
+ * @param file name
+ * @param job, or null on the main thread
+ */
+void GraphicsModel::construct(const string& fn, Worker::Job* job) {
+    shared_ptr<StereoCamera> sCam = store->find(Mpo().cameraModel(fn));
+    bool calibrated = (sCam && sCam->isValid());
+    Pipeline pipe = (calibrated ? Pipeline::reconstruction(sCam) : Pipeline::decoding());
+    const size_t nStgs = pipe.stages().size();
+    Pipeline::Frame frm;
+    frm.fn = fn;
+    pipe.run(frm, [&](const Pipeline::Frame& frm, const Pipeline::Stage& stage) {
+        if (job) {
+            job->checkpoint();
+        }
+        double prog = (double)frm.timings.size() / (double)nStgs;
+        if (stage.name == Pipeline::DECODE) {
+            shared_ptr<Image> img(new Image(frm.imgs));
+            string desc = (calibrated ? "Rectifying the stereo image" : "Stereo camera is not calibrated");
+            // the polygon of the previous file is discarded
+            unsigned int changes = ImageChanged | CloudChanged | MeshChanged;
+            publish(job, Stage::Opened, changes, (calibrated ? prog : 1.0), desc, [=]() {
+                this->img = img;
+                ply.reset();
+            });
+        } else if (stage.name == Pipeline::RECTIFY) {
+            shared_ptr<Image> img(new Image(frm.imgs));
+            publish(job, Stage::Rectified, ImageChanged, prog, "Computing the disparity map", [=]() {
+                this->img = img;
+            });
+        } else if (stage.name == Pipeline::DISPARITY) {
+            vector<Image> imgs(frm.imgs);
+            imgs.push_back(frm.dispImg);
+            shared_ptr<Image> img(new Image(imgs));
+            publish(job, Stage::Disparity, ImageChanged, prog, "Constructing the point cloud", [=]() {
+                this->img = img;
+            });
+        } else if (stage.name == Pipeline::FILTER) {
+            // the polygon is not read by the observers until the next stage is notified
+            shared_ptr<Polygon> ply = frm.ply;
+            publish(job, Stage::PointCloud, CloudChanged | MeshChanged, prog, "Constructing the polygon mesh", [=]() {
+                this->ply = ply;
+            });
+        }
+    });
+    // the polygon mesh is triangulated in the point cloud that is already published
+    vector<Pipeline::Timing> tms = frm.timings;
+    unsigned int changes = (calibrated ? (unsigned int)MeshChanged : 0);
+    string desc("Stereo camera is not calibrated");
+    if (calibrated) {
+        desc = "Done, peak memory " + MemoryStats::format((double)MemoryStats::peakResidentBytes());
     }
-    this->img.reset(new Image(img));
-    notify();
+    publish(job, Stage::Complete, changes, 1.0, desc, [=]() {
+        timings = tms;
+        timingsSig.emit(timings);
+    });
 }
 
 /**
@@ -60,26 +213,161 @@ void GraphicsModel::open(const string& fn) {
  * @param distance corners or centers on the calibration rig pattern
  */
 void GraphicsModel::calibrate(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist) {
-    img.reset();
-    sCam.reset();
+    beginUpdate();
+    try {
+        calibrate(fns, ptn, rows, cols, dist, nullptr);
+    } catch (...) {
+        endUpdate();
+        throw;
+    }
+    endUpdate();
+}
+
+/**
+ * Calibrate the stereo camera by the background worker
+ * The job in progress is cancelled, and the error is reported by the error signal.
+ * @param file names
+ * @param type of the calibration rig pattern
+ * @param number of rows on the calibration rig pattern
+ * @param number of columns on the calibration rig pattern
+ * @param distance corners or centers on the calibration rig pattern
+ */
+void GraphicsModel::calibrateAsync(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist) {
+    worker.start([=](Worker::Job& job) {
+        try {
+            calibrate(fns, ptn, rows, cols, dist, &job);
+        } catch (const string& msg) {
+            fail(job, msg);
+        } catch (const exception& ex) {
+            fail(job, ex.what());
+        }
+    });
+}
+
+/**
+ * Calibrate the stereo camera
+ * The profile of the camera model is replaced only when the calibration is succeeded,
+ * and the calibration is started from the previous profile.
+ * The files whose detections are cached are not decoded,
+ * and only the other files are detected.
+ * @param file names
+ * @param type of the calibration rig pattern
+ * @param number of rows on the calibration rig pattern
+ * @param number of columns on the calibration rig pattern
+ * @param distance corners or centers on the calibration rig pattern
+ * @param job, or null on the main thread
+ */
+void GraphicsModel::calibrate(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist,
+        Worker::Job* job) {
     if (fns.size() < StereoCamera::MINOFNIMAGES) {
         throw string("Number of MPO must be 3 or more");
     }
-    // open the calibration rig images
+    // find the cached detections, and open the calibration rig images of the others
     Mpo mpo;
+    vector<DetectionCache::Entry> entries(fns.size());
+    vector<uint64_t> keys(fns.size());
+    vector<size_t> idxs;    // indexes of the files that are detected
     vector<Image> imgs[2];
-    for_each(fns.begin(), fns.end(), [&](const string& fn) {
-        vector<Image> img = mpo.open(fn);
+    string model;
+    for (size_t i = 0; i < fns.size(); i++) {
+        progress(job, (double)i / (double)(fns.size() + 1), "Opening " + fns[i]);
+        vector<uchar> data = mpo.read(fns[i]);
+        if (i == 0) {
+            model = mpo.cameraModel(data);
+        } else if (mpo.cameraModel(data) != model) {
+            throw string("Camera model must be the same: ") + fns[i];
+        }
+        keys[i] = DetectionCache::key(data, ptn, rows, cols);
+        if (dtctCache.find(keys[i], entries[i])) {
+            continue;
+        }
+        vector<Image> img = mpo.decode(data);
         if (img.size() != 2) {
             throw string("Number of image must be 2");
         }
         imgs[0].push_back(img[0]);
         imgs[1].push_back(img[1]);
+        idxs.push_back(i);
+    }
+    if (job) {
+        job->checkpoint();
+    }
+    progress(job, (double)fns.size() / (double)(fns.size() + 1), "Calibrating the stereo camera");
+    // the copy of the profile is calibrated, and it is started from the previous parameters
+    shared_ptr<StereoCamera> sCam = store->find(model);
+    if (!sCam) {
+        sCam.reset(new StereoCamera);
+    }
+    // detect the calibration rig pattern in the opened images
+    string desc("Done");
+    if (!idxs.empty()) {
+        try {
+            sCam->detectPatterns(imgs, ptn, rows, cols);
+        } catch (const string& msg) {
+            // report the files in which the pattern is not detected
+            string err;
+            for (int i = 0; i < 2; i++) {
+                const vector<StereoCamera::Detection>& dtcts = sCam->detections(i);
+                for (size_t j = 0; j < dtcts.size(); j++) {
+                    if (!dtcts[j].error.empty()) {
+                        err += (err.empty() ? "" : ", ") + fns[idxs[j]] + (i == 0 ? " (left): " : " (right): ");
+                        err += dtcts[j].error;
+                    }
+                }
+            }
+            throw (err.empty() ? msg : err);
+        }
+        double maxMsec = 0.0;
+        for (size_t j = 0; j < idxs.size(); j++) {
+            DetectionCache::Entry& entry = entries[idxs[j]];
+            for (int i = 0; i < 2; i++) {
+                const StereoCamera::Detection& dtct = sCam->detections(i)[j];
+                entry.centers[i] = dtct.centers;
+                // report the slowest detection of the pattern
+                if (maxMsec < dtct.msec) {
+                    maxMsec = dtct.msec;
+                    desc = "Done, the slowest detection is " + to_string((int)maxMsec) + " ms in " + fns[idxs[j]];
+                }
+            }
+            entry.size = imgs[0][j].size();
+            entry.thumbnail = DetectionCache::thumbnail(imgs[0][j]);
+            dtctCache.insert(keys[idxs[j]], entry);
+        }
+    }
+    // calibrate the stereo camera by all the detections
+    vector<vector<cv::Point2f>> imgPts[2];
+    vector<Image> thumbs;
+    for_each(entries.begin(), entries.end(), [&](const DetectionCache::Entry& entry) {
+        if (entry.size != entries[0].size) {
+            throw string("Size of image must be the same");
+        }
+        imgPts[0].push_back(entry.centers[0]);
+        imgPts[1].push_back(entry.centers[1]);
+        thumbs.push_back(entry.thumbnail);
     });
-    sCam.reset(new StereoCamera);
-    // calibrate the stereo camera
-    sCam->calibrate(imgs, ptn, rows, cols, dist);
-    img.reset(new Image(imgs[0]));
-    notify();
+    sCam->calibrate(imgPts, entries[0].size, rows, cols, dist);
+    shared_ptr<Image> img(new Image(thumbs));
+    // the profile is replaced and saved on the main thread,
+    // which is not invoked if the job is cancelled
+    publish(job, Stage::Calibrated, ImageChanged | CalibrationChanged, 1.0, desc, [=]() {
+        store->insert(model, *sCam);
+        this->img = img;
+        try {
+            store->save();
+        } catch (const string& msg) {
+            errorSig.emit(msg);
+        }
+    });
+}
+
+/**
+ * Cancel the background job
+ * The job stops at the next stage, and its result is discarded.
+ */
+void GraphicsModel::cancel() {
+    if (worker.isBusy()) {
+        worker.cancel();
+        progressSig.emit(0.0, Worker::CANCELLED);
+    }
 }
 
@@ -3,6 +3,16 @@
  *  - The model of the model/view architecture is implemented.
  *  - Subject class is inherited.
  *  - The Image, StereoCamera and Polygon objects are instantiated.
+ *  - The 3D polygon is constructed by the stages of the pipeline,
+ *    and the observers are notified as each stage of the construction is completed.
+ *  - The observers are notified of which of the image, the calibration,
+ *    the point cloud and the polygon mesh are changed.
+ *  - The 3D polygon is constructed and the stereo camera is calibrated
+ *    by the background worker, and the results are notified on the main thread.
+ *  - The detections of the calibration rig pattern are cached by the files,
+ *    then only the added files are detected when the stereo camera is calibrated again.
+ *  - The stereo camera is selected from the calibration store
+ *    by the camera model of the MPO file.
  * 
  * File:   GraphicsModel.h
  * Author: munehiro
@@ -13,10 +23,15 @@
 #ifndef GRAPHICSMODEL_H
 #define	GRAPHICSMODEL_H
 
+#include <functional>
 #include <memory>
 #include <vector>
 #include "Subject.h"
 #include "RigDialog.h"
+#include "Worker.h"
+#include "Pipeline.h"
+#include "DetectionCache.h"
+#include "CalibrationStore.h"
 
 using namespace std;
 
@@ -26,18 +41,67 @@ class Polygon;
 
 class GraphicsModel : public Subject {
 public:
+    // the stage of the construction of the 3D polygon
+    enum struct Stage : int {
+        Opened,     // the stereo image is opened
+        Rectified,  // the stereo image is rectified
+        Disparity,  // the disparity map is computed
+        PointCloud, // the 3D point cloud is constructed
+        Complete,   // the 3D polygon is constructed
+        Calibrated  // the stereo camera is calibrated
+    };
+    // the changes of the model that are notified to the observers
+    enum Change : unsigned int {
+        ImageChanged        = 1 << 0,   // the image
+        CalibrationChanged  = 1 << 1,   // the stereo camera
+        CloudChanged        = 1 << 2,   // the 3D point cloud
+        MeshChanged         = 1 << 3    // the polygon mesh
+    };
     GraphicsModel();
     virtual ~GraphicsModel();
+    // get the stage that is notified last
+    Stage stage() const { return stg; };
+    // verify whether the construction or the calibration is completed
+    bool isComplete() const { return (stg == Stage::Complete || stg == Stage::Calibrated); };
+    // verify whether the background job is running
+    bool isBusy() const { return worker.isBusy(); };
     void open(const string& fn);
     void calibrate(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist);
+    void openAsync(const string& fn);
+    void calibrateAsync(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist);
+    void cancel();
+    // get the signal of the progress of the background job, that is emitted on the main thread
+    sigc::signal<void, double, const string&>& signalProgress() { return progressSig; };
+    // get the signal of the error of the background job, that is emitted on the main thread
+    sigc::signal<void, const string&>& signalError() { return errorSig; };
+    // get the signal of the time and the memory of each stage when the construction is completed
+    sigc::signal<void, const vector<Pipeline::Timing>&>& signalTimings() { return timingsSig; };
     // get the image
     Image* image() const { return img.get(); };
     // get the polygon
     Polygon* polygon() const { return ply.get(); };
+    // get the time and the memory of each stage of the last construction
+    const vector<Pipeline::Timing>& stageTimings() const { return timings; };
 private:
+    void notify(Stage stg, unsigned int changes);
+    void construct(const string& fn, Worker::Job* job);
+    void calibrate(const vector<string>& fns, RigDialog::Pattern ptn, int rows, int cols, double dist,
+                   Worker::Job* job);
+    void publish(Worker::Job* job, Stage stg, unsigned int changes, double progress, const string& desc,
+                 const function<void()>& set);
+    void progress(Worker::Job* job, double progress, const string& desc);
+    void fail(Worker::Job& job, const string& msg);
+    Stage stg;                      // stage that is notified last
     shared_ptr<Image> img;          // image
-    shared_ptr<StereoCamera> sCam;  // stereo camera
+    shared_ptr<CalibrationStore> store; // calibrated stereo cameras
     shared_ptr<Polygon> ply;        // 3D polygon
+    vector<Pipeline::Timing> timings;   // time of each stage of the last construction
+    DetectionCache dtctCache;           // detections of the calibration rig pattern
+    sigc::signal<void, double, const string&> progressSig; // signal of the progress
+    sigc::signal<void, const string&> errorSig;             // signal of the error
+    sigc::signal<void, const vector<Pipeline::Timing>&> timingsSig; // signal of the stage timings
+    // background worker, which is destroyed first to stop the job
+    Worker worker;
 
 };
 
@@ -4,8 +4,12 @@
  *  - The images are concatenated.
  *  - The corners and the centers are detected
  *    in the chessboard and the circle grid image.
+ *  - The chessboard corners are found in the downscaled image first,
+ *    and refined in the small windows on the full resolution image.
  *  - The image is translated by the translation map.
  *  - The disparity map is computed.
+ *  - The intermediate images are kept in the buffers of the frame context
+ *    if it is given, and the image shares the data with the buffer.
  * 
  * File:   Image.cpp
  * Author: munehiro
@@ -13,7 +17,13 @@
  * Created on March 1, 2014, 12:30 AM
  */
 
+#include <cfloat>
+#include <cmath>
 #include "Image.h"
+#include "FrameContext.h"
+
+const cv::TermCriteria Image::SUBPIXCRITERIA(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 30, 0.01);
+const int Image::DETECTWIDTH = 1024;
 
 /**
  * Constructors and Destructor
@@ -36,6 +46,15 @@ Image::Image(const cv::Mat& orig) {
 Image::~Image() {
 }
 
+/**
+ * Share the data of the matrix
+ * The data is not copied, then the matrix must not be changed while the image is used.
+ * @param matrix
+ */
+void Image::share(const cv::Mat& mat) {
+    img = mat;
+}
+
 /**
  * Get the image that convert to RGB
  * @return image
@@ -74,23 +93,59 @@ void Image::concatenate(const vector<Image>& imgs) {
 
 /**
  * Find the corners in the chessboard images
+ * The chessboard is searched from the image downscaled to DETECTWIDTH
+ * up to the full resolution image, and the search is stopped when it is found.
+ * The image without the chessboard is rejected quickly at each downscaled try,
+ * and the full resolution image is searched without the quick check as the fallback.
+ * The corners are mapped to the full resolution, and refined
+ * in the windows that are sized by the scale and the size of the squares.
  * @param number of rows to find
  * @param number of columns to find
+ * @param criteria to refine the corners to the sub-pixel accuracy
  * @return chessboard corners
  */
-vector<cv::Point2f> Image::findChessboardCorners(int rows, int cols) {
+vector<cv::Point2f> Image::findChessboardCorners(int rows, int cols, const cv::TermCriteria& crit) {
     if (img.empty()) {
         throw string("Image is empty");
     }
     vector<cv::Point2f> corners;
     cv::Mat gray;
     cv::cvtColor(img, gray, CV_BGR2GRAY);
-    if (!cv::findChessboardCorners(gray, cvSize(cols, rows), corners,
-            CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_NORMALIZE_IMAGE)) {
+    const int flags = CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_NORMALIZE_IMAGE;
+    // the scales from the coarsest to the full resolution
+    vector<double> scls(1, 1.0);
+    for (double scl = 2.0; gray.cols / scl >= DETECTWIDTH / 2; scl *= 2.0) {
+        scls.insert(scls.begin(), scl);
+    }
+    bool found = false;
+    double scl = 1.0;
+    for (size_t i = 0; i < scls.size() && !found; i++) {
+        scl = scls[i];
+        if (scl == 1.0) {
+            found = cv::findChessboardCorners(gray, cvSize(cols, rows), corners, flags);
+            continue;
+        }
+        cv::Mat small;
+        cv::resize(gray, small, cv::Size(), 1.0 / scl, 1.0 / scl, cv::INTER_AREA);
+        found = cv::findChessboardCorners(small, cvSize(cols, rows), corners, flags | CV_CALIB_CB_FAST_CHECK);
+    }
+    if (!found) {
         throw string("Could not find chessboard corners");
     }
-    cv::cornerSubPix(gray, corners, cvSize(5,5), cvSize(-1,-1),
-            cv::TermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 1000, 1.0e-8));
+    // map the corners to the full resolution by the centers of the pixels
+    for_each(corners.begin(), corners.end(), [&](cv::Point2f& pt) {
+        pt.x = (float)((pt.x + 0.5) * scl - 0.5);
+        pt.y = (float)((pt.y + 0.5) * scl - 0.5);
+    });
+    // the window covers the error of the scale, and does not exceed the half of the squares
+    double minDist = DBL_MAX;
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j + 1 < cols; j++) {
+            minDist = min(minDist, (double)cv::norm(corners[i*cols+j+1] - corners[i*cols+j]));
+        }
+    }
+    int win = (int)max(2.0, min(ceil(2.0 * scl) + 3.0, minDist / 2.0 - 1.0));
+    cv::cornerSubPix(gray, corners, cvSize(win, win), cvSize(-1,-1), crit);
     cv::drawChessboardCorners(img, cvSize(cols, rows), corners, true);
     return corners;
 }
@@ -121,14 +176,28 @@ vector<cv::Point2f> Image::findCircleGrid(int rows, int cols) {
  * @param translation map
  */
 void Image::remap(const cv::Mat* rmap) {
+    cv::Mat buf;
+    remap(rmap, buf);
+}
+
+/**
+ * Translate the image into the buffer by using the translation map
+ * The image shares the data with the buffer after the translation.
+ * @param translation map
+ * @param buffer, which is reused if its size and type are the same
+ */
+void Image::remap(const cv::Mat* rmap, cv::Mat& buf) {
     if (img.empty()) {
         throw string("Image is empty");
     }
     if (!rmap) {
         throw string("Map is empty");
     }
-    cv::Mat src = img.clone();
-    cv::remap(src, img, rmap[0], rmap[1], CV_INTER_LINEAR);
+    if (buf.data == img.data) {
+        buf.release();
+    }
+    cv::remap(img, buf, rmap[0], rmap[1], CV_INTER_LINEAR);
+    img = buf;
 }
 
 /**
@@ -171,9 +240,10 @@ Image Image::computeDisparityMapBM(const vector<Image>& imgs, const cv::Rect* ro
 /**
  * Compute disparity map by using Semi Global Block Matching
  * @param stereo image
+ * @param frame context for the buffers, or null
  * @return disparity map
  */
-Image Image::computeDisparityMapSGBM(const vector<Image>& imgs) {
+Image Image::computeDisparityMapSGBM(const vector<Image>& imgs, FrameContext* ctx) {
     if (imgs.empty()) {
         throw string("Image is empty");
     }
@@ -183,15 +253,24 @@ Image Image::computeDisparityMapSGBM(const vector<Image>& imgs) {
     cv::StereoSGBM sgbm(0, nDisp, sadWinSize,
             8*ch*sadWinSize*sadWinSize, 32*ch*sadWinSize*sadWinSize,
             1, 63, 10, 100, 32, true);
-    cv::Mat gray[2], disp;
-    cv::cvtColor(imgs[0].img, gray[0], CV_BGR2GRAY);
-    cv::cvtColor(imgs[1].img, gray[1], CV_BGR2GRAY);
-    sgbm(gray[0], gray[1], disp);
+    cv::Mat tmp[6];
+    auto buf = [&](int i, const string& name) -> cv::Mat& { return (ctx ? ctx->mat(name) : tmp[i]); };
+    cv::Mat& gray0 = buf(0, "sgbm.gray0");
+    cv::Mat& gray1 = buf(1, "sgbm.gray1");
+    cv::Mat& disp = buf(2, "sgbm.disp");
+    cv::cvtColor(imgs[0].img, gray0, CV_BGR2GRAY);
+    cv::cvtColor(imgs[1].img, gray1, CV_BGR2GRAY);
+    sgbm(gray0, gray1, disp);
     
-    cv::Mat dispGray, dispBGR;
-    disp.convertTo(img, CV_32F, 1.0/16.0);
+    cv::Mat& dispF = buf(3, "sgbm.dispF");
+    cv::Mat& dispGray = buf(4, "sgbm.dispGray");
+    cv::Mat& dispBGR = buf(5, "sgbm.dispBGR");
+    disp.convertTo(dispF, CV_32F, 1.0/16.0);
+    img = dispF;
     disp.convertTo(dispGray, CV_8U, 255.0/(nDisp*16.0));
     cv::cvtColor(dispGray, dispBGR, CV_GRAY2BGR);
-    return Image(dispBGR);
+    Image dispImg;
+    dispImg.share(dispBGR);
+    return dispImg;
 }
 
@@ -4,8 +4,12 @@
  *  - The images are concatenated.
  *  - The corners and the centers are detected
  *    in the chessboard and the circle grid image.
+ *  - The chessboard corners are found in the downscaled image first,
+ *    and refined in the small windows on the full resolution image.
  *  - The image is translated by the translation map.
  *  - The disparity map is computed.
+ *  - The intermediate images are kept in the buffers of the frame context
+ *    if it is given, and the image shares the data with the buffer.
  * 
  * File:   Image.h
  * Author: munehiro
@@ -21,8 +25,14 @@
 
 using namespace std;
 
+class FrameContext;
+
 class Image {
 public:
+    // default criteria to refine the corners to the sub-pixel accuracy
+    static const cv::TermCriteria SUBPIXCRITERIA;
+    // maximum width of the image to find the chessboard at first
+    static const int DETECTWIDTH;
     Image();
     Image(const Image& orig);
     Image(const vector<Image>& orig);
@@ -42,13 +52,16 @@ public:
     uchar* data() const { return img.data; };
     // get image as the cv::Mat
     const cv::Mat& image() const { return img; };
+    void share(const cv::Mat& mat);
     Image rgbImage() const;
     void concatenate(const vector<Image>& imgs);
-    vector<cv::Point2f> findChessboardCorners(int rows, int cols);
+    vector<cv::Point2f> findChessboardCorners(int rows, int cols,
+                                              const cv::TermCriteria& crit = SUBPIXCRITERIA);
     vector<cv::Point2f> findCircleGrid(int rows, int cols);
     void remap(const cv::Mat* rmap);
+    void remap(const cv::Mat* rmap, cv::Mat& buf);
     Image computeDisparityMapBM(const vector<Image>& imgs, const cv::Rect* roi);
-    Image computeDisparityMapSGBM(const vector<Image>& imgs);
+    Image computeDisparityMapSGBM(const vector<Image>& imgs, FrameContext* ctx = nullptr);
 private:
     cv::Mat img;    // image
 
@@ -3,6 +3,8 @@
  *  - The view of the model/view architecture is implemented
  *    to draw the image.
  *  - Gtk::DrawingArea of Gtkmm Library and Observer class are inherited.
+ *  - The rectified image and the disparity map are drawn
+ *    while the 3D polygon is constructed.
  * 
  * File:   ImageView.cpp
  * Author: munehiro
@@ -14,6 +16,8 @@
 #include "GraphicsModel.h"
 #include "Image.h"
 
+const double ImageView::AREARATIO = 0.5;
+
 /**
  * Constructor and Destructor
  */
@@ -25,16 +29,28 @@ ImageView::~ImageView() {
 
 /**
  * Update the image view
+ * The image is converted only when it is changed.
  * @param subject
+ * @param mask of the changes
  */
-void ImageView::update(const Subject* subject) {
+void ImageView::update(const Subject* subject, unsigned int changes) {
+    const GraphicsModel* model = (const GraphicsModel*)subject;
+    if (!(changes & GraphicsModel::ImageChanged)) {
+        return;
+    }
     this->img.reset();
-    Image* img = ((GraphicsModel*)subject)->image();
+    pixbuf.reset();
+    scaled.release();
+    Image* img = model->image();
     if (img && !img->isEmpty()) {
         // get the image
         // the color order of OpenCV is BGR, then convert BGR to RGB
         this->img.reset(new Image(img->rgbImage()));
         queue_draw();
+        // the intermediate image is drawn before the next stage is begun
+        if (!model->isComplete() && is_realized()) {
+            get_window()->process_updates(false);
+        }
     }
 }
 
@@ -73,12 +89,35 @@ bool ImageView::on_expose_event(GdkEventExpose* event) {
         w = (int)(hr * (double)iw);
         h = wh;
     }
-    Glib::RefPtr<Gdk::Pixbuf> pixbuf = Gdk::Pixbuf::create_from_data((const guint8*)img->data(),
-            Gdk::COLORSPACE_RGB, false, 8, iw, ih, img->rowstride())->scale_simple(w, h, Gdk::INTERP_BILINEAR);
+    if (w <= 0 || h <= 0) {
+        return true;
+    }
+    // the scaled image is rebuilt only when the image or the size is changed
+    if (!pixbuf || pixbuf->get_width() != w || pixbuf->get_height() != h) {
+        scale(w, h);
+    }
     Cairo::RefPtr<Cairo::Context> context = get_window()->create_cairo_context();
+    context->rectangle(event->area.x, event->area.y, event->area.width, event->area.height);
+    context->clip();
     Gdk::Cairo::set_source_pixbuf(context, pixbuf, 0, 0);
     context->paint();
 
     return true;
 }
 
+/**
+ * Scale the image to the pixbuf
+ * The large downscale is averaged by the area interpolation,
+ * and the others are interpolated bilinearly.
+ * @param width of the pixbuf
+ * @param height of the pixbuf
+ */
+void ImageView::scale(int w, int h) {
+    pixbuf.reset();
+    double ratio = min((double)w / (double)img->width(), (double)h / (double)img->height());
+    cv::resize(img->image(), scaled, cv::Size(w, h), 0.0, 0.0,
+            (ratio < AREARATIO ? cv::INTER_AREA : cv::INTER_LINEAR));
+    pixbuf = Gdk::Pixbuf::create_from_data((const guint8*)scaled.data,
+            Gdk::COLORSPACE_RGB, false, 8, scaled.cols, scaled.rows, scaled.step);
+}
+
@@ -3,6 +3,8 @@
  *  - The view of the model/view architecture is implemented
  *    to draw the image.
  *  - Gtk::DrawingArea of Gtkmm Library and Observer class are inherited.
+ *  - The rectified image and the disparity map are drawn
+ *    while the 3D polygon is constructed.
  * 
  * File:   ImageView.h
  * Author: munehiro
@@ -15,6 +17,7 @@
 
 #include <memory>
 #include <gtkmm-2.4/gtkmm.h>
+#include <opencv2/opencv.hpp>
 #include "Observer.h"
 
 using namespace std;
@@ -25,12 +28,17 @@ class ImageView : public Gtk::DrawingArea, public Observer {
 public:
     ImageView();
     virtual ~ImageView();
-    virtual void update(const Subject* subject);
+    virtual void update(const Subject* subject, unsigned int changes);
 protected:
     virtual void on_realize();
     virtual bool on_expose_event(GdkEventExpose* event);
 private:
+    // the ratio of the downscale by the area interpolation
+    static const double AREARATIO;
+    void scale(int w, int h);
     shared_ptr<Image> img;  // image
+    cv::Mat scaled;         // image scaled to the window, the pixel data of the pixbuf
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf;   // cached pixbuf of the scaled image
 
 };
 
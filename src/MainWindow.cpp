@@ -3,9 +3,14 @@
  *  - The main window of this application.
  *  - There are 2 views, the one is the polygon view
  *    and the other is the image view.
- *  - There are 4 menus that open the MPO file to construct the 3D polygon,
- *    quit this application, calibrate the stereo camera
- *    and set the calibration rig properties.
+ *  - There are 11 menus that open the MPO file to construct the 3D polygon,
+ *    cancel the construction or the calibration, quit this application,
+ *    show or hide the point cloud, the edges and the surfaces,
+ *    select the finer or the coarser level of detail,
+ *    show or hide the render statistics,
+ *    calibrate the stereo camera and set the calibration rig properties.
+ *  - The progress of the construction and the calibration is shown
+ *    in the status bar.
  * 
  * File:   MainWindow.cpp
  * Author: munehiro
@@ -13,6 +18,8 @@
  * Created on February 28, 2014, 6:00 PM
  */
 
+#include <iostream>
+#include <sstream>
 #include <vector>
 #include "MainWindow.h"
 #include "MpoFileDialog.h"
@@ -27,7 +34,7 @@
  */
 MainWindow::MainWindow(BaseObjectType* object, const Glib::RefPtr<Gtk::Builder>& builder)
 : Gtk::Window(object)
-, ptn(RigDialog::Pattern::Chessboard), rows(6), cols(9), dist(27.0) {
+, statusbar(nullptr), ptn(RigDialog::Pattern::Chessboard), rows(6), cols(9), dist(27.0) {
     // set the model/view architecture
     model.reset(new GraphicsModel);
     iView.reset(new ImageView);
@@ -35,20 +42,42 @@ MainWindow::MainWindow(BaseObjectType* object, const Glib::RefPtr<Gtk::Builder>&
     model->attach(iView);
     model->attach(sView);
     // relate between the widget and the variable
-    Gtk::ImageMenuItem *openMenu, *quitMenu;
-    Gtk::MenuItem *calibMenu, *rigMenu;
+    Gtk::ImageMenuItem *openMenu, *cancelMenu, *quitMenu;
+    Gtk::CheckMenuItem *pointsMenu, *edgesMenu, *surfaceMenu, *statsMenu;
+    Gtk::MenuItem *finerMenu, *coarserMenu, *calibMenu, *rigMenu;
     Gtk::Viewport *imageView, *sceneView;
     builder->get_widget("open_menuitem", openMenu);
+    builder->get_widget("cancel_menuitem", cancelMenu);
     builder->get_widget("quit_menuitem", quitMenu);
+    builder->get_widget("points_menuitem", pointsMenu);
+    builder->get_widget("edges_menuitem", edgesMenu);
+    builder->get_widget("surface_menuitem", surfaceMenu);
+    builder->get_widget("finer_menuitem", finerMenu);
+    builder->get_widget("coarser_menuitem", coarserMenu);
+    builder->get_widget("stats_menuitem", statsMenu);
     builder->get_widget("calib_menuitem", calibMenu);
     builder->get_widget("rig_menuitem", rigMenu);
     builder->get_widget("image_view", imageView);
     builder->get_widget("scene_view", sceneView);
+    builder->get_widget("statusbar", statusbar);
     // set the signal and the slot
     openMenu->signal_activate().connect(sigc::mem_fun(*this, &MainWindow::open));
+    cancelMenu->signal_activate().connect(sigc::mem_fun(*model, &GraphicsModel::cancel));
     quitMenu->signal_activate().connect(sigc::mem_fun(*this, &MainWindow::hide));
+    pointsMenu->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::showLayer),
+            SceneView::Layer::PointCloud, pointsMenu));
+    edgesMenu->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::showLayer),
+            SceneView::Layer::Edges, edgesMenu));
+    surfaceMenu->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::showLayer),
+            SceneView::Layer::Surface, surfaceMenu));
+    finerMenu->signal_activate().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::selectLevelOfDetail), -1));
+    coarserMenu->signal_activate().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::selectLevelOfDetail), 1));
+    statsMenu->signal_toggled().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::showStats), statsMenu));
     calibMenu->signal_activate().connect(sigc::mem_fun(*this, &MainWindow::calibrate));
     rigMenu->signal_activate().connect(sigc::mem_fun(*this, &MainWindow::editRigProperty));
+    model->signalProgress().connect(sigc::mem_fun(*this, &MainWindow::showProgress));
+    model->signalError().connect(sigc::mem_fun(*this, &MainWindow::showError));
+    model->signalTimings().connect(sigc::mem_fun(*this, &MainWindow::showTimings));
     // add the image and the scene view to the viewport
     imageView->add(*iView);
     sceneView->add(*sView);
@@ -61,6 +90,8 @@ MainWindow::~MainWindow() {
 
 /**
  * Open the MPO file
+ * The 3D polygon is constructed in the background,
+ * and the construction in progress is cancelled.
  */
 void MainWindow::open() {
     MpoFileDialog dlg(*this, "Choose a MPO file");
@@ -68,16 +99,12 @@ void MainWindow::open() {
         return;
     }
     string fn = dlg.get_filename();
-    try {
-        model->open(fn);
-    } catch (const string& msg) {
-        Gtk::MessageDialog dlg(msg, false, Gtk::MESSAGE_WARNING);
-        dlg.run();
-    }
+    model->openAsync(fn);
 }
 
 /**
  * Calibrate the stereo camera
+ * The stereo camera is calibrated in the background.
  */
 void MainWindow::calibrate() {
     MpoFileDialog dlg(*this, "Choose MPO files");
@@ -86,13 +113,7 @@ void MainWindow::calibrate() {
         return;
     }
     vector<string> fns = dlg.get_filenames();
-    try {
-        model->calibrate(fns, ptn, rows, cols, dist);
-    } catch (const string& msg) {
-        Gtk::MessageDialog dlg(msg, false, Gtk::MESSAGE_WARNING);
-        
-        dlg.run();
-    }
+    model->calibrateAsync(fns, ptn, rows, cols, dist);
 }
 
 /**
@@ -126,3 +147,65 @@ void MainWindow::editRigProperty() {
     }
 }
 
+/**
+ * Show or hide the layer of the scene view
+ * @param layer
+ * @param check menu item of the layer
+ */
+void MainWindow::showLayer(SceneView::Layer layer, Gtk::CheckMenuItem* item) {
+    sView->setLayerVisible(layer, item->get_active());
+}
+
+/**
+ * Select the finer or the coarser level of detail of the scene view
+ * @param step of the level, the negative is finer and the positive is coarser
+ */
+void MainWindow::selectLevelOfDetail(int step) {
+    int lod = (int)sView->levelOfDetail() + step;
+    int maxLod = (int)sView->nLevelsOfDetail() - 1;
+    lod = (lod > maxLod ? maxLod : lod);
+    lod = (lod < 0 ? 0 : lod);
+    sView->setLevelOfDetail(lod);
+}
+
+/**
+ * Show or hide the render statistics of the scene view
+ * The statistics are also written to the standard log.
+ * @param check menu item of the render statistics
+ */
+void MainWindow::showStats(Gtk::CheckMenuItem* item) {
+    sView->setStatsEnabled(item->get_active(), &clog);
+}
+
+/**
+ * Show the progress of the background job in the status bar
+ * @param progress from 0 to 1
+ * @param description of the progress
+ */
+void MainWindow::showProgress(double progress, const string& desc) {
+    ostringstream msg;
+    if (0.0 < progress && progress < 1.0) {
+        msg << (int)(progress * 100.0) << "% ";
+    }
+    msg << desc;
+    statusbar->pop();
+    statusbar->push(msg.str());
+}
+
+/**
+ * Show the error of the background job
+ * @param error message
+ */
+void MainWindow::showError(const string& msg) {
+    Gtk::MessageDialog dlg(msg, false, Gtk::MESSAGE_WARNING);
+    dlg.run();
+}
+
+/**
+ * Write the time and the memory of each stage of the construction to the standard log
+ * @param time and memory of each stage
+ */
+void MainWindow::showTimings(const vector<Pipeline::Timing>& tms) {
+    Pipeline::report(clog, tms);
+}
+
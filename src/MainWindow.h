@@ -3,9 +3,14 @@
  *  - The main window of this application.
  *  - There are 2 views, the one is the polygon view
  *    and the other is the image view.
- *  - There are 4 menus that open the MPO file to construct the 3D polygon,
- *    quit this application, calibrate the stereo camera
- *    and edit the calibration rig properties.
+ *  - There are 11 menus that open the MPO file to construct the 3D polygon,
+ *    cancel the construction or the calibration, quit this application,
+ *    show or hide the point cloud, the edges and the surfaces,
+ *    select the finer or the coarser level of detail,
+ *    show or hide the render statistics,
+ *    calibrate the stereo camera and edit the calibration rig properties.
+ *  - The progress of the construction and the calibration is shown
+ *    in the status bar.
  * 
  * File:   MainWindow.h
  * Author: munehiro
@@ -19,12 +24,13 @@
 #include <memory>
 #include <gtkmm-2.4/gtkmm.h>
 #include "RigDialog.h"
+#include "SceneView.h"
+#include "Pipeline.h"
 
 using namespace std;
 
 class GraphicsModel;
 class ImageView;
-class SceneView;
 
 class MainWindow : public Gtk::Window {
 public:
@@ -34,9 +40,16 @@ private:
     void open();
     void calibrate();
     void editRigProperty();
+    void showLayer(SceneView::Layer layer, Gtk::CheckMenuItem* item);
+    void selectLevelOfDetail(int step);
+    void showStats(Gtk::CheckMenuItem* item);
+    void showProgress(double progress, const string& desc);
+    void showError(const string& msg);
+    void showTimings(const vector<Pipeline::Timing>& tms);
     shared_ptr<GraphicsModel> model;    // model of the model/view architecture
     shared_ptr<ImageView> iView;        // image view of the model/view architecture
     shared_ptr<SceneView> sView;        // scene view of the model/view architecture
+    Gtk::Statusbar* statusbar;  // status bar to show the progress
     RigDialog::Pattern ptn; // type of the calibration rig pattern
     int rows, cols;         // number of rows, columns of the calibration rig pattern
     double dist;            // distance between corners or centers of the calibration rig pattern
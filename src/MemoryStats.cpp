@@ -0,0 +1,83 @@
+/* 
+ * MemoryStats Class
+ *  - The memory usage of the process is measured,
+ *    such as the live bytes of the heap and the peak resident set size.
+ *  - The live bytes include the memory allocated by malloc, new,
+ *    OpenCV and PCL, in all the threads of the process.
+ * 
+ * File:   MemoryStats.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:50 PM
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "MemoryStats.h"
+
+/**
+ * Get the live bytes of the heap
+ * The small blocks in the arenas and the large blocks mapped directly are summed.
+ * @return bytes
+ */
+size_t MemoryStats::liveBytes() {
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#else
+    struct mallinfo mi = mallinfo();
+    // the fields wrap around at 4 GB
+    return (size_t)(unsigned int)mi.uordblks + (size_t)(unsigned int)mi.hblkhd;
+#endif
+}
+
+/**
+ * Get the current resident set size of the process
+ * @return bytes, or 0 if it is not available
+ */
+size_t MemoryStats::residentBytes() {
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (!fp) {
+        return 0;
+    }
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+    return (n == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0);
+}
+
+/**
+ * Get the peak resident set size of the process
+ * @return bytes
+ */
+size_t MemoryStats::peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // the maximum resident set size is in kilobytes
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+/**
+ * Format the bytes in the readable unit
+ * @param bytes, which may be negative for the difference
+ * @return text such as "12.3 MB"
+ */
+string MemoryStats::format(double bytes) {
+    static const char* units[] = { "B", "KB", "MB", "GB" };
+    int unit = 0;
+    while (fabs(bytes) >= 1024.0 && unit < 3) {
+        bytes /= 1024.0;
+        unit++;
+    }
+    ostringstream ss;
+    ss << fixed << setprecision(unit == 0 ? 0 : 1) << bytes << " " << units[unit];
+    return ss.str();
+}
+
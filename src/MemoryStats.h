@@ -0,0 +1,31 @@
+/* 
+ * MemoryStats Class
+ *  - The memory usage of the process is measured,
+ *    such as the live bytes of the heap and the peak resident set size.
+ *  - The live bytes include the memory allocated by malloc, new,
+ *    OpenCV and PCL, in all the threads of the process.
+ * 
+ * File:   MemoryStats.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:50 PM
+ */
+
+#ifndef MEMORYSTATS_H
+#define	MEMORYSTATS_H
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+class MemoryStats {
+public:
+    static size_t liveBytes();
+    static size_t residentBytes();
+    static size_t peakResidentBytes();
+    static string format(double bytes);
+};
+
+#endif	/* MEMORYSTATS_H */
+
@@ -1,6 +1,9 @@
 /* 
  * Mpo Class
  *  - The MPO file is opened and the JPEG data is extracted.
+ *  - The MPO file is read and decoded separately.
+ *  - The camera model is read from the EXIF in APP1.
+ *  - The images are encoded to the MPO in the big or the little endian.
  * 
  * File:   Mpo.cpp
  * Author: munehiro
@@ -9,9 +12,10 @@
  */
 
 #include <fstream>
-#include <boost/shared_array.hpp>
 #include "Mpo.h"
 #include "Image.h"
+#include "FrameContext.h"
+#include "Trace.h"
 
 const int Mpo::COUNTSIZE =  2;
 const int Mpo::FIELDSIZE = 12;
@@ -19,12 +23,22 @@ const int Mpo::ENTRYSIZE = 16;
 const int Mpo::NIMAGESTAG = 0xb001;
 const int Mpo::MPENTRYTAG = 0xb002;
 const int Mpo::NOTJPEG    = 0x0007;
+const int Mpo::VERSIONTAG = 0xb000;
+const uint32_t Mpo::BASELINEATTR  = 0x20020002;
+const uint32_t Mpo::DISPARITYATTR = 0x00020002;
+const int Mpo::MAKETAG    = 0x010f;
+const int Mpo::MODELTAG   = 0x0110;
+const int Mpo::ASCIITYPE  = 2;
+const int Mpo::LONGTYPE   = 4;
+const int Mpo::UNDEFINEDTYPE = 7;
 const uchar Mpo::SOI[]        = { 0xff, 0xd8 };
 const uchar Mpo::APP1MARKER[] = { 0xff, 0xe1 };
 const uchar Mpo::EXIFIDCODE[] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
 const uchar Mpo::APP2MARKER[] = { 0xff, 0xe2 };
 const uchar Mpo::APP2IDCODE[] = { 0x4d, 0x50, 0x46, 0x00 };
 const uchar Mpo::BIGENDCODE[] = { 0x4d, 0x4d, 0x00, 0x2a };
+const uchar Mpo::LTLENDCODE[] = { 0x49, 0x49, 0x2a, 0x00 };
+const uchar Mpo::VERSION[]    = { 0x30, 0x31, 0x30, 0x30 };
 
 /**
  * Constructor and Destructor
@@ -41,6 +55,26 @@ Mpo::~Mpo() {
  * @return images as the Image object
  */
 vector<Image> Mpo::open(const string& fn) const {
+    return decode(read(fn));
+}
+
+/**
+ * Read the MPO file
+ * @param file name
+ * @return MPO data
+ */
+vector<uchar> Mpo::read(const string& fn) const {
+    vector<uchar> mpo;
+    read(fn, mpo);
+    return mpo;
+}
+
+/**
+ * Read the MPO file into the buffer
+ * @param file name
+ * @param buffer of the MPO data, which is reused if its capacity is enough
+ */
+void Mpo::read(const string& fn, vector<uchar>& mpo) const {
     // open the MPO file
     ifstream file(fn.c_str(), ios::in | ios::binary);
     if (!file) {
@@ -50,11 +84,261 @@ vector<Image> Mpo::open(const string& fn) const {
     }
     ulong mpoSize = file.seekg(0, ios::end).tellg();
     file.seekg(0, ios::beg);
-    boost::shared_array<uchar> mpo(new uchar[mpoSize]);
-    file.read((char*)mpo.get(), mpoSize);
+    mpo.resize(mpoSize);
+    file.read((char*)mpo.data(), mpoSize);
     file.close();
+}
+
+/**
+ * Decode the MPO data
+ * @param MPO data
+ * @param frame context for the buffers of the images, or null
+ * @return images as the Image object
+ */
+vector<Image> Mpo::decode(const vector<uchar>& mpo, FrameContext* ctx) const {
+    const uchar* mpHead;
+    {
+        TRACE_SCOPE("mpo.parse");
+        mpHead = mpHeader(mpo.data(), mpo.size());
+    }
     // extract the JPEG data and convert to the Image object
-    return extractJpeg(mpo.get(), mpHeader(mpo.get(), mpoSize));
+    return extractJpeg(mpo.data(), mpo.size(), mpHead, ctx);
+}
+
+/**
+ * Get the camera model of the MPO file
+ * Only the head of the file, which contains APP1, is read.
+ * @param file name
+ * @return maker and model of the camera, or empty if they are not recorded
+ */
+string Mpo::cameraModel(const string& fn) const {
+    ifstream file(fn.c_str(), ios::in | ios::binary);
+    if (!file) {
+        string msg("Could not open ");
+        msg += fn;
+        throw msg;
+    }
+    // SOI, APP1 marker and APP1 of the maximum size
+    vector<uchar> head(sizeof(SOI) + sizeof(APP1MARKER) + 0xffff);
+    file.read((char*)head.data(), head.size());
+    head.resize(file.gcount());
+    return cameraModel(head);
+}
+
+/**
+ * Get the camera model from the EXIF in APP1
+ * @param MPO data, or its head
+ * @return maker and model of the camera, or empty if they are not recorded
+ */
+string Mpo::cameraModel(const vector<uchar>& mpo) const {
+    const size_t tiffOffset = sizeof(SOI) + sizeof(APP1MARKER) + 2 + sizeof(EXIFIDCODE);
+    if (mpo.size() < tiffOffset ||
+        strncmp((char*)&mpo[0], (char*)SOI, 2) != 0        ||
+        strncmp((char*)&mpo[2], (char*)APP1MARKER, 2) != 0 ||
+        strncmp((char*)&mpo[6], (char*)EXIFIDCODE, 6) != 0) {
+        throw string("Invalid MPO");
+    }
+    // TIFF header and IFD0 in APP1, whose size includes the size field
+    size_t app1Size = (size_t)mpo[4] << 8 | mpo[5];
+    if (app1Size < 2 + sizeof(EXIFIDCODE) + 8) {
+        return string();
+    }
+    const uchar* tiff = &mpo[tiffOffset];
+    const size_t tiffSize = min(app1Size - 2 - sizeof(EXIFIDCODE), mpo.size() - tiffOffset);
+    bool bigEnd = (strncmp((char*)tiff, (char*)BIGENDCODE, 4) == 0);
+    auto read16 = [&](size_t ofs) -> size_t {
+        return (bigEnd ? (size_t)tiff[ofs] << 8 | tiff[ofs+1] : (size_t)tiff[ofs+1] << 8 | tiff[ofs]);
+    };
+    auto read32 = [&](size_t ofs) -> size_t {
+        return (bigEnd ? read16(ofs) << 16 | read16(ofs+2) : read16(ofs+2) << 16 | read16(ofs));
+    };
+    size_t ifd = read32(4);
+    if (ifd + 2 > tiffSize) {
+        return string();
+    }
+    string make, model;
+    size_t count = read16(ifd);
+    for (size_t i = 0; i < count && ifd + 2 + FIELDSIZE * (i + 1) <= tiffSize; i++) {
+        size_t field = ifd + 2 + FIELDSIZE * i;
+        size_t tag = read16(field);
+        if ((tag != (size_t)MAKETAG && tag != (size_t)MODELTAG) || read16(field+2) != (size_t)ASCIITYPE) {
+            continue;
+        }
+        // the value of 4 bytes or less is in the field
+        size_t len = read32(field+4);
+        size_t ofs = (len <= 4 ? field + 8 : read32(field+8));
+        if (ofs >= tiffSize || len > tiffSize - ofs) {
+            continue;
+        }
+        string val((const char*)tiff + ofs, len);
+        val = val.substr(0, val.find('\0'));
+        val = val.substr(0, val.find_last_not_of(' ') + 1);
+        (tag == (size_t)MAKETAG ? make : model) = val;
+    }
+    return (make.empty() || model.empty() ? make + model : make + " " + model);
+}
+
+/**
+ * Encode the images to the MPO
+ * The first image has the EXIF in APP1 and the MP index IFD in APP2,
+ * and the others have the MP attribute IFD in APP2.
+ * @param images, the first is the left image
+ * @param maker of the camera
+ * @param model of the camera
+ * @param the TIFF headers are in the big endian or the little endian
+ * @param quality of JPEG from 0 to 100
+ * @return MPO data
+ */
+vector<uchar> Mpo::encode(const vector<Image>& imgs, const string& make, const string& model,
+        bool bigEnd, int quality) const {
+    if (imgs.empty()) {
+        throw string("Image is empty");
+    }
+    // encode the images to JPEG
+    vector<vector<uchar>> jpgs(imgs.size());
+    vector<int> params = { CV_IMWRITE_JPEG_QUALITY, quality };
+    for (size_t i = 0; i < imgs.size(); i++) {
+        if (!cv::imencode(".jpg", imgs[i].image(), jpgs[i], params) || jpgs[i].size() < sizeof(SOI)) {
+            throw string("Could not encode JPEG");
+        }
+    }
+    // the size of the MP index IFD does not depend on the values of the MP entries
+    const vector<uchar> exif = exifSegment(make, model, bigEnd);
+    const vector<uchar> attrMpf = mpfSegment(vector<uint32_t>(), vector<uint32_t>(), bigEnd);
+    const size_t idxMpfSize = mpfSegment(vector<uint32_t>(imgs.size()), vector<uint32_t>(imgs.size()), bigEnd).size();
+    // the offsets are from the MP header in APP2 of the first image
+    const size_t mpHeadPos = sizeof(SOI) + exif.size() + sizeof(APP2MARKER) + 2 + sizeof(APP2IDCODE);
+    vector<uint32_t> sizes(imgs.size()), offsets(imgs.size(), 0);
+    size_t pos = 0;
+    for (size_t i = 0; i < imgs.size(); i++) {
+        size_t segSize = (i == 0 ? exif.size() + idxMpfSize : attrMpf.size());
+        sizes[i] = (uint32_t)(jpgs[i].size() + segSize);
+        offsets[i] = (uint32_t)(i == 0 ? 0 : pos - mpHeadPos);
+        pos += sizes[i];
+    }
+    if (pos > 0xffffffffUL) {
+        throw string("MPO is too large");
+    }
+    // insert the segments after SOI of each JPEG
+    vector<uchar> mpo;
+    mpo.reserve(pos);
+    for (size_t i = 0; i < imgs.size(); i++) {
+        mpo.insert(mpo.end(), SOI, SOI + sizeof(SOI));
+        if (i == 0) {
+            vector<uchar> idxMpf = mpfSegment(sizes, offsets, bigEnd);
+            mpo.insert(mpo.end(), exif.begin(), exif.end());
+            mpo.insert(mpo.end(), idxMpf.begin(), idxMpf.end());
+        } else {
+            mpo.insert(mpo.end(), attrMpf.begin(), attrMpf.end());
+        }
+        mpo.insert(mpo.end(), jpgs[i].begin() + sizeof(SOI), jpgs[i].end());
+    }
+    return mpo;
+}
+
+/**
+ * Write the MPO data to the file
+ * @param file name
+ * @param MPO data
+ */
+void Mpo::write(const string& fn, const vector<uchar>& mpo) const {
+    ofstream file(fn.c_str(), ios::out | ios::binary);
+    if (!file || !file.write((const char*)mpo.data(), mpo.size())) {
+        string msg("Could not write ");
+        msg += fn;
+        throw msg;
+    }
+}
+
+/**
+ * Create APP1 of the EXIF with the maker and the model of the camera
+ * @param maker of the camera
+ * @param model of the camera
+ * @param the TIFF header is in the big endian or the little endian
+ * @return APP1 with the marker
+ */
+vector<uchar> Mpo::exifSegment(const string& make, const string& model, bool bigEnd) {
+    const string vals[] = { make, model };
+    const int tags[] = { MAKETAG, MODELTAG };
+    // TIFF header and IFD0, which is followed by the values longer than 4 bytes
+    vector<uchar> tiff(bigEnd ? BIGENDCODE : LTLENDCODE, (bigEnd ? BIGENDCODE : LTLENDCODE) + 4);
+    append32(tiff, 8, bigEnd);
+    append16(tiff, 2, bigEnd);
+    vector<uchar> data;
+    const size_t dataOfs = 8 + COUNTSIZE + FIELDSIZE * 2 + 4;
+    for (int i = 0; i < 2; i++) {
+        vector<uchar> val(vals[i].begin(), vals[i].end());
+        val.push_back('\0');
+        append16(tiff, (uint16_t)tags[i], bigEnd);
+        append16(tiff, (uint16_t)ASCIITYPE, bigEnd);
+        append32(tiff, (uint32_t)val.size(), bigEnd);
+        if (val.size() <= 4) {
+            val.resize(4, '\0');
+            tiff.insert(tiff.end(), val.begin(), val.end());
+        } else {
+            append32(tiff, (uint32_t)(dataOfs + data.size()), bigEnd);
+            data.insert(data.end(), val.begin(), val.end());
+        }
+    }
+    append32(tiff, 0, bigEnd);
+    tiff.insert(tiff.end(), data.begin(), data.end());
+    // the size of the segment is in the big endian, and includes the size field
+    const size_t size = 2 + sizeof(EXIFIDCODE) + tiff.size();
+    if (size > 0xffff) {
+        throw string("Camera model is too long");
+    }
+    vector<uchar> seg(APP1MARKER, APP1MARKER + sizeof(APP1MARKER));
+    append16(seg, (uint16_t)size, true);
+    seg.insert(seg.end(), EXIFIDCODE, EXIFIDCODE + sizeof(EXIFIDCODE));
+    seg.insert(seg.end(), tiff.begin(), tiff.end());
+    return seg;
+}
+
+/**
+ * Create APP2 of the MP format
+ * The MP index IFD with the MP entries is created if the sizes are given,
+ * otherwise the MP attribute IFD with only the version is created.
+ * @param sizes of the images
+ * @param offsets of the images from the MP header, the first is 0
+ * @param the MP header is in the big endian or the little endian
+ * @return APP2 with the marker
+ */
+vector<uchar> Mpo::mpfSegment(const vector<uint32_t>& sizes, const vector<uint32_t>& offsets, bool bigEnd) {
+    const bool isIndex = !sizes.empty();
+    const uint16_t count = (isIndex ? 3 : 1);
+    // MP header and the IFD, which is followed by the MP entries
+    vector<uchar> head(bigEnd ? BIGENDCODE : LTLENDCODE, (bigEnd ? BIGENDCODE : LTLENDCODE) + 4);
+    append32(head, 8, bigEnd);
+    append16(head, count, bigEnd);
+    append16(head, (uint16_t)VERSIONTAG, bigEnd);
+    append16(head, (uint16_t)UNDEFINEDTYPE, bigEnd);
+    append32(head, sizeof(VERSION), bigEnd);
+    head.insert(head.end(), VERSION, VERSION + sizeof(VERSION));
+    if (isIndex) {
+        append16(head, (uint16_t)NIMAGESTAG, bigEnd);
+        append16(head, (uint16_t)LONGTYPE, bigEnd);
+        append32(head, 1, bigEnd);
+        append32(head, (uint32_t)sizes.size(), bigEnd);
+        append16(head, (uint16_t)MPENTRYTAG, bigEnd);
+        append16(head, (uint16_t)UNDEFINEDTYPE, bigEnd);
+        append32(head, (uint32_t)(ENTRYSIZE * sizes.size()), bigEnd);
+        append32(head, (uint32_t)(8 + COUNTSIZE + FIELDSIZE * count + 4), bigEnd);
+    }
+    append32(head, 0, bigEnd);
+    for (size_t i = 0; i < sizes.size(); i++) {
+        append32(head, (i == 0 ? BASELINEATTR : DISPARITYATTR), bigEnd);
+        append32(head, sizes[i], bigEnd);
+        append32(head, offsets[i], bigEnd);
+        // no dependent images
+        append16(head, 0, bigEnd);
+        append16(head, 0, bigEnd);
+    }
+    // the size of the segment is in the big endian, and includes the size field
+    vector<uchar> seg(APP2MARKER, APP2MARKER + sizeof(APP2MARKER));
+    append16(seg, (uint16_t)(2 + sizeof(APP2IDCODE) + head.size()), true);
+    seg.insert(seg.end(), APP2IDCODE, APP2IDCODE + sizeof(APP2IDCODE));
+    seg.insert(seg.end(), head.begin(), head.end());
+    return seg;
 }
 
 /**
@@ -63,18 +347,23 @@ vector<Image> Mpo::open(const string& fn) const {
  * @param MPO data size
  * @return MP header
  */
-const uchar* Mpo::mpHeader(const uchar* mpo, ulong mpoSize) const {
-    if (mpoSize == 0L || !mpo) {
+const uchar* Mpo::mpHeader(const uchar* mpo, size_t mpoSize) const {
+    if (mpoSize == 0 || !mpo) {
         throw string("MPO is empty");
     }
     // verify APP1
-    if (strncmp((char*)&mpo[0], (char*)SOI, 2) != 0        ||
+    if (mpoSize < sizeof(SOI) + sizeof(APP1MARKER) + 2 + sizeof(EXIFIDCODE) ||
+        strncmp((char*)&mpo[0], (char*)SOI, 2) != 0        ||
         strncmp((char*)&mpo[2], (char*)APP1MARKER, 2) != 0 ||
         strncmp((char*)&mpo[6], (char*)EXIFIDCODE, 6) != 0) {
         throw string("Invalid MPO");
     }
-    ushort app1Size = sizeof(APP1MARKER) + toLtlEnd((ushort*)&mpo[4]);
-    // verify APP2
+    // the size of the segment is in the big endian
+    size_t app1Size = sizeof(APP1MARKER) + read16(&mpo[4], true);
+    // verify APP2 and the MP header
+    if (sizeof(SOI) + app1Size + 16 > mpoSize) {
+        throw string("Invalid MPO");
+    }
     const uchar* app2 = &mpo[sizeof(SOI)+app1Size];
     if (strncmp((char*)app2, (char*)APP2MARKER, 2) != 0 ||
         strncmp((char*)(app2+4), (char*)APP2IDCODE, 4) != 0) {
@@ -85,41 +374,63 @@ const uchar* Mpo::mpHeader(const uchar* mpo, ulong mpoSize) const {
 
 /**
  * Extract the JPEG data and convert to the Image object
+ * The JPEG data is decoded in place, and the images are decoded
+ * into the buffers of the frame context if it is given.
  * @param MPO data
+ * @param MPO data size
  * @param MP Header
+ * @param frame context for the buffers of the images, or null
  * @return images as the Image object
  */
-vector<Image> Mpo::extractJpeg(const uchar* mpo, const uchar* mpHead) const {
+vector<Image> Mpo::extractJpeg(const uchar* mpo, size_t mpoSize, const uchar* mpHead, FrameContext* ctx) const {
+    // the ranges are verified by the offsets from the head of the MPO data
+    const size_t headOfs = mpHead - mpo;
+    auto isInMpo = [&](size_t ofs, size_t size) { return (ofs <= mpoSize && size <= mpoSize - ofs); };
     // verify MP
-    bool bigEnd = (strncmp((char*)mpHead, (char*)BIGENDCODE, 4) == 0 ? true : false);
-    const uchar* mpIdxIfd = mpHead + (bigEnd ? toLtlEnd((ulong*)(mpHead+4)) : *(ulong*)(mpHead+4));
-    const ushort count = (bigEnd ? toLtlEnd((ushort*)mpIdxIfd) : *(ushort*)mpIdxIfd);
-    const uchar* mpIdx = mpIdxIfd + COUNTSIZE;
-    ulong mpEntryOffset = 0L;
-    ulong nJpgs = 0L;
+    bool bigEnd = (strncmp((char*)mpHead, (char*)BIGENDCODE, 4) == 0);
+    const size_t mpIdxIfd = headOfs + read32(mpHead+4, bigEnd);
+    if (!isInMpo(mpIdxIfd, COUNTSIZE)) {
+        throw string("Invalid MPO");
+    }
+    const uint16_t count = read16(mpo+mpIdxIfd, bigEnd);
+    if (!isInMpo(mpIdxIfd + COUNTSIZE, (size_t)FIELDSIZE * count)) {
+        throw string("Invalid MPO");
+    }
+    const uchar* mpIdx = mpo + mpIdxIfd + COUNTSIZE;
+    uint32_t mpEntryOffset = 0;
+    uint32_t nJpgs = 0;
     for (int i = 0; i < count; i++, mpIdx += FIELDSIZE) {
-        ushort tag = (bigEnd ? toLtlEnd((ushort*)mpIdx) : *(ushort*)mpIdx);
+        uint16_t tag = read16(mpIdx, bigEnd);
         if (tag == NIMAGESTAG) {
-            nJpgs = (bigEnd ? toLtlEnd((ulong*)(mpIdx+8)) : *(ulong*)(mpIdx+8));
+            nJpgs = read32(mpIdx+8, bigEnd);
         } else if (tag == MPENTRYTAG) {
-            mpEntryOffset = (bigEnd ? toLtlEnd((ulong*)(mpIdx+8)) : *(ulong*)(mpIdx+8));
+            mpEntryOffset = read32(mpIdx+8, bigEnd);
         }
     }
+    if (!isInMpo(headOfs + mpEntryOffset, (size_t)ENTRYSIZE * nJpgs)) {
+        throw string("Invalid MPO");
+    }
     // extract the JPEG data and convert to the Image object
     vector<Image> jpgs;
-    for (uint i = 0; i < (uint)nJpgs; i++) {
-        const uchar* mpEntries = mpHead+mpEntryOffset;
-        const uchar* mpEntry = mpEntries + ENTRYSIZE * i;
-        if (*mpEntry & NOTJPEG) {
+    jpgs.reserve(nJpgs);
+    for (uint32_t i = 0; i < nJpgs; i++) {
+        const uchar* mpEntry = mpHead + mpEntryOffset + ENTRYSIZE * i;
+        // the image data format is in the bits 24 to 26 of the attribute
+        if ((read32(mpEntry, bigEnd) >> 24) & NOTJPEG) {
+            throw string("Invalid JPEG");
+        }
+        uint32_t jpgSize = read32(mpEntry+4, bigEnd);
+        size_t offset = (i == 0 ? 0 : headOfs + read32(mpEntry+8, bigEnd));
+        if (jpgSize == 0 || !isInMpo(offset, jpgSize)) {
             throw string("Invalid JPEG");
         }
-        ulong jpgSize = (bigEnd ? toLtlEnd((ulong*)(mpEntry+4)) : *(ulong*)(mpEntry+4));
-        ulong offset = (bigEnd ? toLtlEnd((ulong*)(mpEntry+8)) : *(ulong*)(mpEntry+8));
-        const uchar* jpgPtr = (i == 0 ? mpo : mpHead+offset);
-        vector<uchar> jpg;
-        jpg.reserve(jpgSize);
-        copy(jpgPtr, jpgPtr+jpgSize, back_inserter(jpg));
-        jpgs.push_back(Image(cv::imdecode(jpg, CV_LOAD_IMAGE_COLOR)));
+        cv::Mat jpg(1, (int)jpgSize, CV_8U, (void*)(mpo + offset));
+        cv::Mat tmp;
+        cv::Mat& dst = (ctx ? ctx->mat("jpeg" + to_string(i)) : tmp);
+        TRACE_SCOPE("jpeg.decode");
+        cv::imdecode(jpg, CV_LOAD_IMAGE_COLOR, &dst);
+        jpgs.push_back(Image());
+        jpgs.back().share(dst);
     }
     return jpgs;
 }
@@ -1,6 +1,9 @@
 /* 
  * Mpo Class
  *  - The MPO file is opened and the JPEG is extracted.
+ *  - The MPO file is read and decoded separately.
+ *  - The camera model is read from the EXIF in APP1.
+ *  - The images are encoded to the MPO in the big or the little endian.
  * 
  * File:   Mpo.h
  * Author: munehiro
@@ -11,18 +14,28 @@
 #ifndef MPO_H
 #define	MPO_H
 
+#include <cstdint>
 #include <vector>
 #include <opencv2/opencv.hpp>
 
 using namespace std;
 
 class Image;
+class FrameContext;
 
 class Mpo {
 public:
     Mpo();
     virtual ~Mpo();
     vector<Image> open(const string& fn) const;
+    vector<uchar> read(const string& fn) const;
+    void read(const string& fn, vector<uchar>& mpo) const;
+    vector<Image> decode(const vector<uchar>& mpo, FrameContext* ctx = nullptr) const;
+    string cameraModel(const string& fn) const;
+    string cameraModel(const vector<uchar>& mpo) const;
+    vector<uchar> encode(const vector<Image>& imgs, const string& make, const string& model,
+                         bool bigEnd = true, int quality = 95) const;
+    void write(const string& fn, const vector<uchar>& mpo) const;
 private:
     static const int COUNTSIZE;         // byte of MP entry's count
     static const int FIELDSIZE;         // byte of MP entry field
@@ -30,24 +43,44 @@ private:
     static const int NIMAGESTAG;        // tag of image number
     static const int MPENTRYTAG;        // tag of MP entry
     static const int NOTJPEG;           // not JPEG flag
+    static const int VERSIONTAG;        // tag of MPF version
+    static const uint32_t BASELINEATTR; // attribute of the representative image of the disparity images
+    static const uint32_t DISPARITYATTR;    // attribute of the disparity image
+    static const int MAKETAG;           // tag of the maker of the camera
+    static const int MODELTAG;          // tag of the model of the camera
+    static const int ASCIITYPE;         // type of the ASCII field
+    static const int LONGTYPE;          // type of the LONG field
+    static const int UNDEFINEDTYPE;     // type of the UNDEFINED field
     static const uchar SOI[];           // start of image
     static const uchar APP1MARKER[];    // APP1 marker
     static const uchar APP2MARKER[];    // APP2 marker
     static const uchar APP2IDCODE[];    // APP2 ID code
     static const uchar EXIFIDCODE[];    // EXIF ID code
     static const uchar BIGENDCODE[];    // big endian ID code
-    const uchar* mpHeader(const uchar* mpo, ulong mpoSize) const;
-    vector<Image> extractJpeg(const uchar* mpo, const uchar* mpHead) const;
-    // convert to little endian
-    ushort toLtlEnd(const ushort* val) const {
-        return (*val >> 8 | *val << 8);
+    static const uchar LTLENDCODE[];    // little endian ID code
+    static const uchar VERSION[];       // MPF version
+    const uchar* mpHeader(const uchar* mpo, size_t mpoSize) const;
+    vector<Image> extractJpeg(const uchar* mpo, size_t mpoSize, const uchar* mpHead, FrameContext* ctx) const;
+    static vector<uchar> exifSegment(const string& make, const string& model, bool bigEnd);
+    static vector<uchar> mpfSegment(const vector<uint32_t>& sizes, const vector<uint32_t>& offsets, bool bigEnd);
+    // read the 16 bits value in the byte order
+    static uint16_t read16(const uchar* p, bool bigEnd) {
+        return (bigEnd ? p[0] << 8 | p[1] : p[1] << 8 | p[0]);
     };
-    // convert to little endian
-    ulong  toLtlEnd(const ulong* val) const {
-        return (*val >> 24 |
-               (*val >> 8 & 0x0000ff00) |
-               (*val << 8 & 0x00ff0000) |
-                *val << 24);
+    // read the 32 bits value in the byte order
+    static uint32_t read32(const uchar* p, bool bigEnd) {
+        return (bigEnd ? (uint32_t)read16(p, true) << 16 | read16(p+2, true)
+                       : (uint32_t)read16(p+2, false) << 16 | read16(p, false));
+    };
+    // append the 16 bits value in the byte order
+    static void append16(vector<uchar>& buf, uint16_t val, bool bigEnd) {
+        buf.push_back(bigEnd ? val >> 8 : val & 0xff);
+        buf.push_back(bigEnd ? val & 0xff : val >> 8);
+    };
+    // append the 32 bits value in the byte order
+    static void append32(vector<uchar>& buf, uint32_t val, bool bigEnd) {
+        append16(buf, (uint16_t)(bigEnd ? val >> 16 : val & 0xffff), bigEnd);
+        append16(buf, (uint16_t)(bigEnd ? val & 0xffff : val >> 16), bigEnd);
     };
 
 };
@@ -1,6 +1,7 @@
 /* 
  * Observer class
  *  - The observer of Observer pattern
+ *  - The observer is updated with the mask of the changes of the subject.
  * 
  * File:   Observer.cpp
  * Author: munehiro
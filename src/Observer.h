@@ -1,6 +1,7 @@
 /* 
  * Observer class
  *  - The observer of Observer pattern
+ *  - The observer is updated with the mask of the changes of the subject.
  * 
  * File:   Observer.h
  * Author: munehiro
@@ -17,7 +18,7 @@ class Observer {
 public:
     Observer();
     virtual ~Observer();
-    virtual void update(const Subject* subject) = 0;
+    virtual void update(const Subject* subject, unsigned int changes) = 0;
 private:
 
 };
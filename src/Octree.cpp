@@ -0,0 +1,115 @@
+/* 
+ * Octree Class
+ *  - The points are divided by the octree.
+ *  - The points in the node are contiguous in the order of the octree,
+ *    then the node is rendered by a range of the point indexes.
+ *  - The points in the leaf are shuffled,
+ *    then the head of the range is the uniform subsample of the leaf.
+ * 
+ * File:   Octree.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 2:40 PM
+ */
+
+#include <cfloat>
+#include <algorithm>
+#include <random>
+#include "Octree.h"
+
+/**
+ * Constructor and Destructor
+ * @param positions of the points, 3 values per point
+ * @param maximum number of the points in the leaf
+ * @param maximum depth of the octree
+ */
+Octree::Octree(const vector<float>& pos, uint32_t maxLeafPts, int maxDepth)
+: maxLeafPts(maxLeafPts), maxDepth(maxDepth) {
+    uint32_t nPts = pos.size() / 3;
+    ordr.resize(nPts);
+    for (uint32_t i = 0; i < nPts; i++) {
+        ordr[i] = i;
+    }
+    tmp.resize(nPts);
+    build(pos, 0, nPts, 0);
+    vector<uint32_t>().swap(tmp);
+}
+
+Octree::~Octree() {
+}
+
+/**
+ * Verify whether the node is the leaf
+ * @return leaf or not
+ */
+bool Octree::Node::isLeaf() const {
+    for (int i = 0; i < 8; i++) {
+        if (child[i] >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Build the node
+ * @param positions of the points
+ * @param first of the range of the points
+ * @param number of the points
+ * @param depth of the node
+ * @return index of the node
+ */
+int Octree::build(const vector<float>& pos, uint32_t first, uint32_t count, int depth) {
+    Node node;
+    node.first = first;
+    node.count = count;
+    fill_n(node.child, 8, -1);
+    fill_n(node.min, 3,  FLT_MAX);
+    fill_n(node.max, 3, -FLT_MAX);
+    for (uint32_t i = first; i < first + count; i++) {
+        const float* p = &pos[ordr[i]*3];
+        for (int j = 0; j < 3; j++) {
+            node.min[j] = (node.min[j] > p[j] ? p[j] : node.min[j]);
+            node.max[j] = (node.max[j] < p[j] ? p[j] : node.max[j]);
+        }
+    }
+    int idx = nds.size();
+    nds.push_back(node);
+    if (count <= maxLeafPts || depth >= maxDepth) {
+        // shuffle the points in the leaf by the fixed seed
+        mt19937 rng(first);
+        shuffle(ordr.begin() + first, ordr.begin() + first + count, rng);
+        return idx;
+    }
+    // divide the points into the octants by the counting sort
+    float ctr[3];
+    for (int j = 0; j < 3; j++) {
+        ctr[j] = (node.min[j] + node.max[j]) / 2.0f;
+    }
+    auto octant = [&](uint32_t pt) {
+        const float* p = &pos[pt*3];
+        return (p[0] > ctr[0] ? 1 : 0) | (p[1] > ctr[1] ? 2 : 0) | (p[2] > ctr[2] ? 4 : 0);
+    };
+    uint32_t ofs[9] = { 0 };
+    for (uint32_t i = first; i < first + count; i++) {
+        ofs[octant(ordr[i]) + 1]++;
+    }
+    for (int i = 0; i < 8; i++) {
+        ofs[i+1] += ofs[i];
+    }
+    uint32_t fill[8];
+    copy(ofs, ofs + 8, fill);
+    for (uint32_t i = first; i < first + count; i++) {
+        tmp[first + fill[octant(ordr[i])]++] = ordr[i];
+    }
+    copy(tmp.begin() + first, tmp.begin() + first + count, ordr.begin() + first);
+    for (int i = 0; i < 8; i++) {
+        uint32_t n = ofs[i+1] - ofs[i];
+        if (n > 0) {
+            int child = build(pos, first + ofs[i], n, depth + 1);
+            nds[idx].child[i] = child;
+        }
+    }
+    return idx;
+}
+
@@ -0,0 +1,49 @@
+/* 
+ * Octree Class
+ *  - The points are divided by the octree.
+ *  - The points in the node are contiguous in the order of the octree,
+ *    then the node is rendered by a range of the point indexes.
+ *  - The points in the leaf are shuffled,
+ *    then the head of the range is the uniform subsample of the leaf.
+ * 
+ * File:   Octree.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 2:40 PM
+ */
+
+#ifndef OCTREE_H
+#define	OCTREE_H
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class Octree {
+public:
+    // the node of the octree
+    struct Node {
+        float min[3], max[3];   // bounding box of the points
+        uint32_t first, count;  // range of the points in the order of the octree
+        int child[8];           // indexes of the children, or -1
+        bool isLeaf() const;
+    };
+    Octree(const vector<float>& pos, uint32_t maxLeafPts = 4096, int maxDepth = 12);
+    virtual ~Octree();
+    // get the point indexes in the order of the octree
+    const vector<uint32_t>& order() const { return ordr; };
+    // get the nodes, the first node is the root
+    const vector<Node>& nodes() const { return nds; };
+private:
+    int build(const vector<float>& pos, uint32_t first, uint32_t count, int depth);
+    uint32_t maxLeafPts;        // maximum number of the points in the leaf
+    int maxDepth;               // maximum depth of the octree
+    vector<uint32_t> ordr;      // point indexes in the order of the octree
+    vector<uint32_t> tmp;       // work buffer to divide the points
+    vector<Node> nds;           // nodes
+
+};
+
+#endif	/* OCTREE_H */
+
@@ -0,0 +1,204 @@
+/* 
+ * OffscreenRenderer Class
+ *  - The 3D polygon is rendered to the image without the display.
+ *  - The point cloud and the surfaces of the 3D polygon are rasterized
+ *    by the software with the depth buffer.
+ *  - The view is the same orthogonal view as the scene view,
+ *    and the polygon is rotated by the quaternion of the trackball.
+ * 
+ * File:   OffscreenRenderer.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 4:05 PM
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include "OffscreenRenderer.h"
+#include "Polygon.h"
+#include "Vertex.h"
+#include "Parallel.h"
+#include "Trace.h"
+extern "C" {
+    #include "trackball.h"
+}
+
+const double OffscreenRenderer::EYEPOINT = 30.0;
+const double OffscreenRenderer::NEARCLIP = EYEPOINT - 10.0;
+const double OffscreenRenderer::FARCLIP  = EYEPOINT + 10.0;
+
+/**
+ * Constructor and Destructor
+ * @param width of the image
+ * @param height of the image
+ */
+OffscreenRenderer::OffscreenRenderer(int width, int height)
+: width(width), height(height), points(true), surface(true), frmTime(0.0) {
+    if (width <= 0 || height <= 0) {
+        throw string("Invalid image size");
+    }
+    // orthogonal view
+    double aspect = (double)width / (double)height;
+    viewW = (height < width ? aspect : 1.0);
+    viewH = (height < width ? 1.0 : 1.0 / aspect);
+    img = cv::Mat::zeros(height, width, CV_8UC3);
+    depth.resize(width * height);
+}
+
+OffscreenRenderer::~OffscreenRenderer() {
+}
+
+/**
+ * Set the 3D polygon to be rendered
+ * @param 3D polygon
+ * @param level of detail
+ */
+void OffscreenRenderer::setModel(const Polygon& ply, size_t lod) {
+    positions.clear();
+    colors.clear();
+    faceIdxs.reset();
+    if (!ply.isValid()) {
+        return;
+    }
+    vector<Vertex> vtcs = ply.normalizedVertices();
+    positions.reserve(vtcs.size() * 3);
+    colors.reserve(vtcs.size() * 3);
+    for_each(vtcs.begin(), vtcs.end(), [&](const Vertex& vtx) {
+        const double* pos = vtx.position3d();
+        const uchar* col = vtx.color3b();
+        positions.insert(positions.end(), { (float)pos[0], (float)pos[1], (float)pos[2] });
+        colors.insert(colors.end(), { col[0], col[1], col[2] });
+    });
+    faceIdxs = ply.faceIndexes(lod);
+}
+
+/**
+ * Set the layers to be rendered
+ * @param the point cloud is rendered or not
+ * @param the surfaces are rendered or not
+ */
+void OffscreenRenderer::setLayers(bool points, bool surface) {
+    this->points = points;
+    this->surface = surface;
+}
+
+/**
+ * Render the 3D polygon
+ * @param quaternion for the polygon rotation
+ * @param scale of the polygon
+ * @return rendered image
+ */
+const cv::Mat& OffscreenRenderer::render(const float* q, double scl) {
+    TRACE_SCOPE("offscreen.render");
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    float m[4][4], quat[4] = { q[0], q[1], q[2], q[3] };
+    build_rotmatrix(m, quat);
+    // transform the vertices to the screen
+    const size_t nVtcs = positions.size() / 3;
+    screen.resize(nVtcs * 3);
+    Parallel::range(nVtcs, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float* p = &positions[i*3];
+            double e[3];
+            for (int j = 0; j < 3; j++) {
+                e[j] = scl * (m[0][j] * p[0] + m[1][j] * p[1] + m[2][j] * p[2] + m[3][j]);
+            }
+            e[2] -= EYEPOINT;
+            screen[i*3]   = (float)((e[0] / viewW + 1.0) / 2.0 * width);
+            screen[i*3+1] = (float)((1.0 - e[1] / viewH) / 2.0 * height);
+            screen[i*3+2] = (float)-e[2];
+        }
+    });
+    // rasterize the bands of the rows
+    img.setTo(cv::Scalar::all(0));
+    fill(depth.begin(), depth.end(), FLT_MAX);
+    Parallel::range(height, [&](size_t begin, size_t end) {
+        rasterize(begin, end);
+    }, 16);
+    frmTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return img;
+}
+
+/**
+ * Save the rendered image
+ * The format is selected by the extension of the file name, such as PNG.
+ * @param file name
+ */
+void OffscreenRenderer::save(const string& fn) const {
+    if (!cv::imwrite(fn, img)) {
+        string msg("Could not write ");
+        msg += fn;
+        throw msg;
+    }
+}
+
+/**
+ * Rasterize the surfaces and the point cloud in the rows
+ * @param first row
+ * @param end row
+ */
+void OffscreenRenderer::rasterize(size_t begin, size_t end) {
+    auto inClip = [&](float z) { return (z >= NEARCLIP && z <= FARCLIP); };
+    if (surface && faceIdxs) {
+        const vector<uint32_t>& idxs = *faceIdxs;
+        for (size_t i = 0; i + 2 < idxs.size(); i += 3) {
+            const float* p0 = &screen[idxs[i]*3];
+            const float* p1 = &screen[idxs[i+1]*3];
+            const float* p2 = &screen[idxs[i+2]*3];
+            if (!inClip(p0[2]) || !inClip(p1[2]) || !inClip(p2[2])) {
+                continue;
+            }
+            float area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+            if (area == 0.0f) {
+                continue;
+            }
+            int minX = max(0, (int)floor(min(p0[0], min(p1[0], p2[0]))));
+            int maxX = min(width - 1, (int)ceil(max(p0[0], max(p1[0], p2[0]))));
+            int minY = max((int)begin, (int)floor(min(p0[1], min(p1[1], p2[1]))));
+            int maxY = min((int)end - 1, (int)ceil(max(p0[1], max(p1[1], p2[1]))));
+            const uchar* c[] = { &colors[idxs[i]*3], &colors[idxs[i+1]*3], &colors[idxs[i+2]*3] };
+            for (int y = minY; y <= maxY; y++) {
+                float py = y + 0.5f;
+                cv::Vec3b* row = img.ptr<cv::Vec3b>(y);
+                for (int x = minX; x <= maxX; x++) {
+                    float px = x + 0.5f;
+                    float w0 = ((p1[0] - px) * (p2[1] - py) - (p2[0] - px) * (p1[1] - py)) / area;
+                    float w1 = ((p2[0] - px) * (p0[1] - py) - (p0[0] - px) * (p2[1] - py)) / area;
+                    float w2 = 1.0f - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                        continue;
+                    }
+                    float z = w0 * p0[2] + w1 * p1[2] + w2 * p2[2];
+                    float& d = depth[y * width + x];
+                    if (z >= d) {
+                        continue;
+                    }
+                    d = z;
+                    for (int j = 0; j < 3; j++) {
+                        row[x][2-j] = (uchar)(w0 * c[0][j] + w1 * c[1][j] + w2 * c[2][j] + 0.5f);
+                    }
+                }
+            }
+        }
+    }
+    if (points) {
+        const size_t nVtcs = screen.size() / 3;
+        for (size_t i = 0; i < nVtcs; i++) {
+            const float* p = &screen[i*3];
+            int x = (int)floor(p[0]);
+            int y = (int)floor(p[1]);
+            if (x < 0 || x >= width || y < (int)begin || y >= (int)end || !inClip(p[2])) {
+                continue;
+            }
+            float& d = depth[y * width + x];
+            if (p[2] > d) {
+                continue;
+            }
+            d = p[2];
+            const uchar* c = &colors[i*3];
+            img.at<cv::Vec3b>(y, x) = cv::Vec3b(c[2], c[1], c[0]);
+        }
+    }
+}
+
@@ -0,0 +1,56 @@
+/* 
+ * OffscreenRenderer Class
+ *  - The 3D polygon is rendered to the image without the display.
+ *  - The point cloud and the surfaces of the 3D polygon are rasterized
+ *    by the software with the depth buffer.
+ *  - The view is the same orthogonal view as the scene view,
+ *    and the polygon is rotated by the quaternion of the trackball.
+ * 
+ * File:   OffscreenRenderer.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 4:05 PM
+ */
+
+#ifndef OFFSCREENRENDERER_H
+#define	OFFSCREENRENDERER_H
+
+#include <memory>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+class Polygon;
+
+class OffscreenRenderer {
+public:
+    OffscreenRenderer(int width, int height);
+    virtual ~OffscreenRenderer();
+    // get the rendered image
+    const cv::Mat& image() const { return img; };
+    // get the time to render the last frame in milliseconds
+    double frameTime() const { return frmTime; };
+    void setModel(const Polygon& ply, size_t lod = 0);
+    void setLayers(bool points, bool surface);
+    const cv::Mat& render(const float* q, double scl = 1.0);
+    void save(const string& fn) const;
+private:
+    // the eye point, the near and the far clip of the view
+    static const double EYEPOINT, NEARCLIP, FARCLIP;
+    void rasterize(size_t begin, size_t end);
+    int width, height;          // size of the image
+    double viewW, viewH;        // half width and height of the orthogonal view
+    vector<float> positions;    // positions of the vertices
+    vector<uchar> colors;       // colors of the vertices in RGB
+    shared_ptr<const vector<uint32_t>> faceIdxs;    // vertex indexes of the surfaces
+    bool points, surface;       // the point cloud and the surfaces are rendered or not
+    vector<float> screen;       // positions of the vertices on the screen and the depths
+    vector<float> depth;        // depth buffer
+    cv::Mat img;                // image in BGR
+    double frmTime;             // time to render the last frame
+
+};
+
+#endif	/* OFFSCREENRENDERER_H */
+
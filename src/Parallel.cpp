@@ -0,0 +1,77 @@
+/* 
+ * Parallel Class
+ *  - The loop is split into the contiguous ranges
+ *    and the ranges are processed by the threads.
+ * 
+ * File:   Parallel.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#include <exception>
+#include <thread>
+#include <vector>
+#include "Parallel.h"
+
+const size_t Parallel::MINOFGRAIN = 1024;
+
+/**
+ * Get the number of the threads
+ * @return number of the hardware threads, at least 1
+ */
+unsigned int Parallel::nThreads() {
+    unsigned int n = thread::hardware_concurrency();
+    return (n == 0 ? 1 : n);
+}
+
+/**
+ * Process the range [0, n) by the threads
+ * The exception thrown by the function is rethrown on the calling thread.
+ * @param number of elements
+ * @param function to process the range [begin, end)
+ * @param minimum number of elements processed by a thread
+ */
+void Parallel::range(size_t n, const function<void(size_t, size_t)>& fn, size_t grain) {
+    if (n == 0) {
+        return;
+    }
+    grain = (grain == 0 ? 1 : grain);
+    size_t nTrds = nThreads();
+    if (nTrds > (n + grain - 1) / grain) {
+        nTrds = (n + grain - 1) / grain;
+    }
+    if (nTrds <= 1) {
+        fn(0, n);
+        return;
+    }
+    // the calling thread processes the last range
+    vector<thread> trds;
+    vector<exception_ptr> errs(nTrds);
+    size_t step = (n + nTrds - 1) / nTrds;
+    for (size_t i = 0; i < nTrds; i++) {
+        size_t begin = i * step;
+        size_t end = (begin + step < n ? begin + step : n);
+        auto task = [&fn, &errs, i, begin, end]() {
+            try {
+                fn(begin, end);
+            } catch (...) {
+                errs[i] = current_exception();
+            }
+        };
+        if (i + 1 < nTrds) {
+            trds.push_back(thread(task));
+        } else {
+            task();
+        }
+    }
+    for (auto& trd : trds) {
+        trd.join();
+    }
+    for (auto& err : errs) {
+        if (err) {
+            rethrow_exception(err);
+        }
+    }
+}
+
@@ -0,0 +1,30 @@
+/* 
+ * Parallel Class
+ *  - The loop is split into the contiguous ranges
+ *    and the ranges are processed by the threads.
+ * 
+ * File:   Parallel.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#ifndef PARALLEL_H
+#define	PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+class Parallel {
+public:
+    // minimum number of elements processed by a thread
+    static const size_t MINOFGRAIN;
+    static unsigned int nThreads();
+    static void range(size_t n, const function<void(size_t, size_t)>& fn, size_t grain = MINOFGRAIN);
+
+};
+
+#endif	/* PARALLEL_H */
+
@@ -0,0 +1,268 @@
+/* 
+ * Pipeline Class
+ *  - The construction of the 3D polygon is modeled as the graph of the stages.
+ *  - Each stage reads and writes the typed data slots of the frame,
+ *    and the stages are run in the order of the dependencies of the slots.
+ *  - The wall time and the CPU time of each stage are recorded in the frame.
+ *  - The bytes of the heap kept by each stage, the live bytes of the heap
+ *    and the peak resident set size after each stage are recorded in the frame.
+ *  - The stage is replaceable by the name.
+ *  - The stereo camera is fixed, or selected for each frame
+ *    from the calibration store by the camera model of the MPO file.
+ *  - The stages keep the intermediate data in the buffers of the frame context,
+ *    which are reused by the next frames.
+ * 
+ * File:   Pipeline.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 7:30 PM
+ */
+
+#include <chrono>
+#include <ctime>
+#include <algorithm>
+#include "Pipeline.h"
+#include "Mpo.h"
+#include "StereoCamera.h"
+#include "CalibrationStore.h"
+#include "Polygon.h"
+#include "FrameContext.h"
+#include "Trace.h"
+#include "MemoryStats.h"
+
+const string Pipeline::READ("read");
+const string Pipeline::DECODE("decode");
+const string Pipeline::RECTIFY("rectify");
+const string Pipeline::DISPARITY("disparity");
+const string Pipeline::REPROJECT("reproject");
+const string Pipeline::FILTER("filter");
+const string Pipeline::NORMALS("normals");
+const string Pipeline::TRIANGULATE("triangulate");
+
+/**
+ * Constructor and Destructor
+ */
+Pipeline::Pipeline() {
+}
+
+Pipeline::~Pipeline() {
+}
+
+/**
+ * Create the pipeline that constructs the 3D polygon from the MPO file
+ * @param calibrated stereo camera
+ * @param the outliers of the point cloud are removed by the statistical filter or not
+ * @return pipeline
+ */
+Pipeline Pipeline::reconstruction(const shared_ptr<StereoCamera>& sCam, bool removeOutliers) {
+    return reconstruction([sCam](const Frame&) { return sCam; }, removeOutliers);
+}
+
+/**
+ * Create the pipeline that constructs the 3D polygon from the MPO file
+ * by the stereo camera for the camera model of each file
+ * @param calibration store
+ * @param the outliers of the point cloud are removed by the statistical filter or not
+ * @return pipeline
+ */
+Pipeline Pipeline::reconstruction(const shared_ptr<CalibrationStore>& store, bool removeOutliers) {
+    return reconstruction([store](const Frame& frm) { return store->find(frm.model); }, removeOutliers);
+}
+
+/**
+ * Create the pipeline that constructs the 3D polygon from the MPO file
+ * @param function to get the stereo camera for the frame
+ * @param the outliers of the point cloud are removed by the statistical filter or not
+ * @return pipeline
+ */
+Pipeline Pipeline::reconstruction(const function<shared_ptr<StereoCamera>(const Frame&)>& camera,
+        bool removeOutliers) {
+    Pipeline pipe = decoding();
+    pipe.add(RECTIFY, { Slot::Images }, { Slot::Rectified }, [camera](Frame& frm) {
+        frm.sCam = camera(frm);
+        if (!frm.sCam || !frm.sCam->isValid()) {
+            throw string("Stereo camera is not calibrated");
+        }
+        frm.qMat = frm.sCam->transformRectification(frm.imgs, &frm.context());
+    });
+    pipe.add(DISPARITY, { Slot::Rectified }, { Slot::Disparity }, [](Frame& frm) {
+        frm.dispImg = frm.disp.computeDisparityMapSGBM(frm.imgs, &frm.context());
+    });
+    pipe.add(REPROJECT, { Slot::Rectified, Slot::Disparity }, { Slot::Vertices }, [](Frame& frm) {
+        // the vertices are filled in the buffer of the context
+        frm.vtcs.swap(frm.context().vertices());
+        frm.sCam->reprojectDisparityTo3D(frm.disp, frm.imgs[0], frm.qMat, frm.vtcs, &frm.context());
+    });
+    pipe.add(FILTER, { Slot::Vertices }, { Slot::PointCloud }, [removeOutliers](Frame& frm) {
+        frm.ply.reset(new Polygon);
+        if (removeOutliers) {
+            frm.ply->setOutlierFilter(Polygon::OutlierFilter::Statistical, Polygon::OUTLIERNBRS, Polygon::OUTLIERTHRESH);
+        }
+        frm.ply->setPointCloud(frm.vtcs, &frm.context());
+        // the buffer of the vertices is returned to the context
+        frm.vtcs.swap(frm.context().vertices());
+    });
+    pipe.add(NORMALS, { Slot::PointCloud }, { Slot::Normals }, [](Frame& frm) {
+        frm.ply->estimateNormals(&frm.context());
+    });
+    pipe.add(TRIANGULATE, { Slot::Normals }, { Slot::Mesh }, [](Frame& frm) {
+        frm.ply->triangulateMesh(&frm.context());
+    });
+    return pipe;
+}
+
+/**
+ * Create the pipeline that decodes the MPO file
+ * @return pipeline
+ */
+Pipeline Pipeline::decoding() {
+    Pipeline pipe;
+    pipe.add(READ, { Slot::File }, { Slot::Mpo }, [](Frame& frm) {
+        // the file is read into the buffer of the context
+        frm.mpo.swap(frm.context().bytes(READ));
+        Mpo().read(frm.fn, frm.mpo);
+        frm.model = Mpo().cameraModel(frm.mpo);
+    });
+    pipe.add(DECODE, { Slot::Mpo }, { Slot::Images }, [](Frame& frm) {
+        frm.imgs = Mpo().decode(frm.mpo, &frm.context());
+        // the buffer of the MPO data is returned to the context
+        frm.mpo.swap(frm.context().bytes(READ));
+        frm.mpo.clear();
+        if (frm.imgs.size() != 2) {
+            throw string("Number of image must be 2");
+        }
+    });
+    return pipe;
+}
+
+/**
+ * Get the context of the frame
+ * The context is acquired from the pool when it is used first,
+ * and it is returned to the pool when the frame is released.
+ * @return context
+ */
+FrameContext& Pipeline::Frame::context() {
+    if (!ctx) {
+        ctx = FrameContext::acquire();
+    }
+    return *ctx;
+}
+
+/**
+ * Add the stage
+ * @param name of the stage
+ * @param slots that are read
+ * @param slots that are written
+ * @param function of the stage
+ */
+void Pipeline::add(const string& name, const vector<Slot>& inputs, const vector<Slot>& outputs,
+        const function<void(Frame&)>& run) {
+    for_each(stgs.begin(), stgs.end(), [&](const Stage& stg) {
+        if (stg.name == name) {
+            throw string("Stage already exists: ") + name;
+        }
+    });
+    Stage stg;
+    stg.name = name;
+    stg.traceName = Trace::intern(name);
+    stg.inputs = inputs;
+    stg.outputs = outputs;
+    stg.run = run;
+    stgs.push_back(stg);
+}
+
+/**
+ * Replace the function of the stage
+ * The slots of the stage are not changed.
+ * @param name of the stage
+ * @param function of the stage
+ */
+void Pipeline::replace(const string& name, const function<void(Frame&)>& run) {
+    auto it = find_if(stgs.begin(), stgs.end(), [&](const Stage& stg) { return stg.name == name; });
+    if (it == stgs.end()) {
+        throw string("No such stage: ") + name;
+    }
+    it->run = run;
+}
+
+/**
+ * Get the order to run the stages
+ * The stage is run after all of its input slots are written,
+ * and the file name is the input of the pipeline.
+ * @return stages in the order to run
+ */
+vector<const Pipeline::Stage*> Pipeline::order() const {
+    vector<bool> written(1 + (int)Slot::Mesh, false);
+    written[(int)Slot::File] = true;
+    vector<const Stage*> ordr;
+    vector<bool> done(stgs.size(), false);
+    while (ordr.size() < stgs.size()) {
+        size_t n = ordr.size();
+        for (size_t i = 0; i < stgs.size(); i++) {
+            const Stage& stg = stgs[i];
+            if (done[i] || any_of(stg.inputs.begin(), stg.inputs.end(), [&](Slot slt) { return !written[(int)slt]; })) {
+                continue;
+            }
+            for_each(stg.outputs.begin(), stg.outputs.end(), [&](Slot slt) { written[(int)slt] = true; });
+            done[i] = true;
+            ordr.push_back(&stg);
+        }
+        if (ordr.size() == n) {
+            throw string("Input of the stage is not written");
+        }
+    }
+    return ordr;
+}
+
+/**
+ * Run the stages for the frame
+ * @param frame, whose file name is set
+ * @param function called after each stage, which may throw to stop the pipeline
+ */
+void Pipeline::run(Frame& frm, const function<void(const Frame&, const Stage&)>& done) const {
+    vector<const Stage*> ordr = order();
+    for_each(ordr.begin(), ordr.end(), [&](const Stage* stg) {
+        runStage(*stg, frm);
+        if (done) {
+            done(frm, *stg);
+        }
+    });
+}
+
+/**
+ * Run the stage for the frame and record the time and the memory
+ * The CPU time and the bytes of the heap include the other threads
+ * of the process running at the same time.
+ * @param stage
+ * @param frame
+ */
+void Pipeline::runStage(const Stage& stg, Frame& frm) {
+    TRACE_SCOPE(stg.traceName);
+    size_t live = MemoryStats::liveBytes();
+    chrono::steady_clock::time_point wall = chrono::steady_clock::now();
+    clock_t cpu = clock();
+    stg.run(frm);
+    Timing tm;
+    tm.name = stg.name;
+    tm.wallMsec = chrono::duration<double, milli>(chrono::steady_clock::now() - wall).count();
+    tm.cpuMsec = 1000.0 * (double)(clock() - cpu) / (double)CLOCKS_PER_SEC;
+    tm.liveBytes = MemoryStats::liveBytes();
+    tm.keptBytes = (long long)tm.liveBytes - (long long)live;
+    tm.peakRss = MemoryStats::peakResidentBytes();
+    frm.timings.push_back(tm);
+}
+
+/**
+ * Write the time and the memory of each stage
+ * @param output stream
+ * @param time and memory of each stage
+ */
+void Pipeline::report(ostream& os, const vector<Timing>& tms) {
+    for_each(tms.begin(), tms.end(), [&](const Timing& tm) {
+        os << tm.name << ": " << tm.wallMsec << " ms (CPU " << tm.cpuMsec << " ms)"
+           << ", kept " << MemoryStats::format((double)tm.keptBytes)
+           << ", live " << MemoryStats::format((double)tm.liveBytes)
+           << ", peak RSS " << MemoryStats::format((double)tm.peakRss) << endl;
+    });
+}
+
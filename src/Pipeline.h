@@ -0,0 +1,114 @@
+/* 
+ * Pipeline Class
+ *  - The construction of the 3D polygon is modeled as the graph of the stages.
+ *  - Each stage reads and writes the typed data slots of the frame,
+ *    and the stages are run in the order of the dependencies of the slots.
+ *  - The wall time and the CPU time of each stage are recorded in the frame.
+ *  - The bytes of the heap kept by each stage, the live bytes of the heap
+ *    and the peak resident set size after each stage are recorded in the frame.
+ *  - The stage is replaceable by the name.
+ *  - The stereo camera is fixed, or selected for each frame
+ *    from the calibration store by the camera model of the MPO file.
+ *  - The stages keep the intermediate data in the buffers of the frame context,
+ *    which are reused by the next frames.
+ * 
+ * File:   Pipeline.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 7:30 PM
+ */
+
+#ifndef PIPELINE_H
+#define	PIPELINE_H
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "Image.h"
+#include "Vertex.h"
+
+using namespace std;
+
+class StereoCamera;
+class CalibrationStore;
+class FrameContext;
+class Polygon;
+
+class Pipeline {
+public:
+    // the data slot of the frame
+    enum struct Slot : int {
+        File,       // file name of the MPO
+        Mpo,        // MPO data
+        Images,     // stereo image
+        Rectified,  // rectified stereo image and Q matrix
+        Disparity,  // disparity map
+        Vertices,   // vertices of the 3D point cloud
+        PointCloud, // 3D point cloud without the outliers
+        Normals,    // normal vectors of the 3D point cloud
+        Mesh        // polygon mesh at the levels of detail
+    };
+    // the time of the stage
+    struct Timing {
+        string name;        // name of the stage
+        double wallMsec;    // wall time in milliseconds
+        double cpuMsec;     // CPU time of the process in milliseconds
+        long long keptBytes;    // bytes of the heap allocated and not freed by the stage
+        size_t liveBytes;       // live bytes of the heap after the stage
+        size_t peakRss;         // peak resident set size of the process after the stage
+    };
+    // the data of the frame that flows through the stages
+    struct Frame {
+        Frame() : index(0) {};
+        string fn;              // file name of the MPO
+        vector<uchar> mpo;      // MPO data
+        string model;           // maker and model of the camera
+        shared_ptr<StereoCamera> sCam;  // stereo camera for the frame
+        vector<Image> imgs;     // stereo image, which is rectified by the rectify stage
+        cv::Mat qMat;           // Q matrix of the rectification
+        Image disp;             // disparity map
+        Image dispImg;          // disparity map to be displayed
+        vector<Vertex> vtcs;    // vertices of the 3D point cloud
+        shared_ptr<Polygon> ply;    // 3D polygon
+        vector<Timing> timings;     // time of each stage that is run
+        size_t index;           // index of the frame in the batch
+        string error;           // error message of the stage that is failed, or empty
+        shared_ptr<FrameContext> ctx;   // buffers of the intermediate data
+        FrameContext& context();
+    };
+    // the stage
+    struct Stage {
+        string name;            // name of the stage
+        const char* traceName;  // name of the trace event
+        vector<Slot> inputs;    // slots that are read
+        vector<Slot> outputs;   // slots that are written
+        function<void(Frame&)> run; // function of the stage
+    };
+    // names of the stages of the reconstruction
+    static const string READ, DECODE, RECTIFY, DISPARITY, REPROJECT, FILTER, NORMALS, TRIANGULATE;
+    Pipeline();
+    virtual ~Pipeline();
+    static Pipeline reconstruction(const shared_ptr<StereoCamera>& sCam, bool removeOutliers = false);
+    static Pipeline reconstruction(const shared_ptr<CalibrationStore>& store, bool removeOutliers = false);
+    static Pipeline decoding();
+    void add(const string& name, const vector<Slot>& inputs, const vector<Slot>& outputs,
+             const function<void(Frame&)>& run);
+    void replace(const string& name, const function<void(Frame&)>& run);
+    // get the stages in the order that they are added
+    const vector<Stage>& stages() const { return stgs; };
+    vector<const Stage*> order() const;
+    void run(Frame& frm, const function<void(const Frame&, const Stage&)>& done = nullptr) const;
+    static void runStage(const Stage& stg, Frame& frm);
+    static void report(ostream& os, const vector<Timing>& tms);
+private:
+    static Pipeline reconstruction(const function<shared_ptr<StereoCamera>(const Frame&)>& camera,
+                                   bool removeOutliers);
+    vector<Stage> stgs;     // stages
+
+};
+
+#endif	/* PIPELINE_H */
+
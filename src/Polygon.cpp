@@ -3,6 +3,13 @@
  *  - The 3D point cloud and the polygon mesh are implemented
  *    by Point Cloud Library (PCL).
  *  - The polygon mesh is constructed by pcl::GreedyProjectionTriangulation
+ *  - The outliers of the point cloud are removed before triangulating,
+ *    if the outlier removal filter is set.
+ *  - The polygon mesh is decimated to the levels of detail after triangulating.
+ *  - The point cloud is available before the polygon mesh is constructed.
+ *  - The polygon mesh constructed outside, such as by the fusion, is also set.
+ *  - The vertices with the normal vectors are available for the registration.
+ *  - The intermediate point clouds are kept in the frame context if it is given.
  * 
  * File:   Polygon.cpp
  * Author: munehiro
@@ -13,18 +20,31 @@
 #include <cfloat>
 #include <cmath>
 #include <pcl-1.7/pcl/kdtree/kdtree_flann.h>
+#include <pcl-1.7/pcl/common/io.h>
 #include <pcl-1.7/pcl/features/normal_3d.h>
 #include <pcl-1.7/pcl/surface/gp3.h>
 #include "Polygon.h"
 #include "Vertex.h"
+#include "Parallel.h"
+#include "Decimator.h"
+#include "FrameContext.h"
+#include "Trace.h"
+
+const int Polygon::OUTLIERNBRS      = 20;
+const double Polygon::OUTLIERTHRESH = 1.0;
+const int Polygon::NOFLODS  = 3;
+const int Polygon::LODRATIO = 4;
+const size_t Polygon::MINOFLODTRIS = 64;
 
 /**
  * Constructors and Destructor
  */
-Polygon::Polygon() : searchRadius(5.0), mu(2.5), scl(1.0f) {
+Polygon::Polygon() : searchRadius(5.0), mu(2.5)
+, outlierFlt(OutlierFilter::None), outlierNbrs(OUTLIERNBRS), outlierThresh(OUTLIERTHRESH), scl(1.0f) {
 }
 
-Polygon::Polygon(const Polygon& orig) : scl(orig.scl) {
+Polygon::Polygon(const Polygon& orig)
+: outlierFlt(orig.outlierFlt), outlierNbrs(orig.outlierNbrs), outlierThresh(orig.outlierThresh), scl(orig.scl) {
     cloudWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
     copy(orig.cloudWithNormals->begin(), orig.cloudWithNormals->end(), cloudWithNormals->begin());
     copy(orig.min, orig.min+3, min);
@@ -34,6 +54,24 @@ Polygon::Polygon(const Polygon& orig) : scl(orig.scl) {
 Polygon::~Polygon() {
 }
 
+/**
+ * Get the vertices of the point cloud
+ * The normal vectors are zero until they are estimated.
+ * @return vertices in millimeters
+ */
+vector<Vertex> Polygon::vertices() const {
+    vector<Vertex> vtcs;
+    vtcs.reserve(cloudWithNormals->size());
+    for_each(cloudWithNormals->begin(), cloudWithNormals->end(), [&](const pcl::PointXYZRGBNormal& pt) {
+        Vertex vtx;
+        vtx.setPosition(pt.x, pt.y, pt.z);
+        vtx.setColor(pt.r, pt.g, pt.b);
+        vtx.setNormal(pt.normal_x, pt.normal_y, pt.normal_z);
+        vtcs.push_back(vtx);
+    });
+    return vtcs;
+}
+
 /**
  * Get the normalized vertices of the point cloud
  * @return vertices
@@ -53,43 +91,48 @@ vector<Vertex> Polygon::normalizedVertices() const {
 }
 
 /**
- * Get the indexes of the polygon mesh vertices
- * @return indexes of the polygon mesh vertices
+ * Get the vertex indexes of the triangles at the level of detail
+ * @param level of detail, the coarsest level is used if it is out of range
+ * @return vertex indexes, 3 indexes per triangle
  */
-vector<vector<uint>> Polygon::faceVertexIndexes() const {
-    vector<vector<uint>> faceVtxIdxs;
-    for_each(triangles->polygons.begin(), triangles->polygons.end(), [&](const pcl::Vertices& vtcs) {
-        vector<uint> vtxIdxs;
-        for_each(vtcs.vertices.begin(), vtcs.vertices.end(), [&](const uint32_t vtx) {
-            vtxIdxs.push_back(vtx);
-        });
-        faceVtxIdxs.push_back(vtxIdxs);
-    });
-    return faceVtxIdxs;
+shared_ptr<const vector<uint32_t>> Polygon::faceIndexes(size_t lod) const {
+    if (faceIdxs.empty()) {
+        return shared_ptr<const vector<uint32_t>>();
+    }
+    return faceIdxs[lod < faceIdxs.size() ? lod : faceIdxs.size() - 1];
 }
 
 /**
- * Set the vertices of the point cloud
+ * Set the vertices of the point cloud and construct the polygon mesh
  * @param vertices
  */
 void Polygon::setVertices(const vector<Vertex>& vtcs) {
+    setPointCloud(vtcs);
+    constructMesh();
+}
+
+/**
+ * Set the vertices of the point cloud
+ * The outliers are removed, and the point cloud is valid without the normal
+ * vectors and the polygon mesh until the mesh is constructed.
+ * @param vertices
+ * @param frame context for the point cloud with the outliers, or null
+ */
+void Polygon::setPointCloud(const vector<Vertex>& vtcs, FrameContext* ctx) {
     if (vtcs.size() == 0) {
         throw string("Point cloud is empty");
     }
+    cloudWithNormals.reset();
+    faceIdxs.clear();
     // set the vertices
-    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-    min[0] = min[1] = min[2] =  FLT_MAX;
-    max[0] = max[1] = max[2] = -FLT_MAX;
+    if (ctx) {
+        cloud = ctx->cloud();
+    } else {
+        cloud.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+    }
+    cloud->reserve(vtcs.size());
     for_each(vtcs.begin(), vtcs.end(), [&](const Vertex& vtx) {
         const double* pos = vtx.position3d();
-        for (int i = 0; i < 3; i++) {
-            if (min[i] > pos[i]) {
-                min[i] = pos[i];
-            }
-            if (max[i] < pos[i]) {
-                max[i] = pos[i];
-            }
-        }
         pcl::PointXYZRGB pt;
         pt.x = pos[0];
         pt.y = pos[1];
@@ -100,37 +143,294 @@ void Polygon::setVertices(const vector<Vertex>& vtcs) {
                   static_cast<uint32_t>(col[2]);
         cloud->push_back(pt);
     });
+    // create the search tree, which is shared by the filter and the normal estimation
+    if (ctx) {
+        cTree = ctx->tree();
+    } else {
+        cTree.reset(new pcl::search::KdTree<pcl::PointXYZRGB>);
+    }
+    cTree->setInputCloud(cloud);
+    // remove the outliers
+    inliers = removeOutliers(cloud, cTree, ctx);
+    if (inliers && inliers->empty()) {
+        throw string("Point cloud is empty");
+    }
+    // the inliers without the normal vectors, which are kept by the polygon
+    cloudWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+    if (ctx) {
+        // the index of the search tree and the point cloud
+        FrameContext::countUnpooled(2);
+    }
+    if (inliers) {
+        pcl::copyPointCloud(*cloud, *inliers, *cloudWithNormals);
+    } else {
+        pcl::copyPointCloud(*cloud, *cloudWithNormals);
+    }
+    computeRange();
+}
+
+/**
+ * Set the polygon mesh that is constructed outside, such as by the fusion
+ * The vertices have the normal vectors, and the mesh is decimated to the levels of detail.
+ * @param vertices
+ * @param vertex indexes of the triangles, 3 indexes per triangle
+ */
+void Polygon::setMesh(const vector<Vertex>& vtcs, const vector<uint32_t>& idxs) {
+    if (vtcs.size() == 0) {
+        throw string("Point cloud is empty");
+    }
+    if (idxs.empty()) {
+        throw string("Surface is empty");
+    }
+    cloud.reset();
+    cTree.reset();
+    inliers.reset();
+    cloudWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
+    cloudWithNormals->reserve(vtcs.size());
+    for_each(vtcs.begin(), vtcs.end(), [&](const Vertex& vtx) {
+        const double* pos = vtx.position3d();
+        const double* nml = vtx.normal3d();
+        const uchar* col = vtx.color3b();
+        pcl::PointXYZRGBNormal pt;
+        pt.x = pos[0];
+        pt.y = pos[1];
+        pt.z = pos[2];
+        pt.normal_x = nml[0];
+        pt.normal_y = nml[1];
+        pt.normal_z = nml[2];
+        pt.curvature = 0.0f;
+        pt.rgba = static_cast<uint32_t>(col[0]) << 16 |
+                  static_cast<uint32_t>(col[1]) <<  8 |
+                  static_cast<uint32_t>(col[2]);
+        cloudWithNormals->push_back(pt);
+    });
+    computeRange();
+    faceIdxs.assign(1, shared_ptr<vector<uint32_t>>(new vector<uint32_t>(idxs)));
+    decimate();
+}
+
+/**
+ * Compute the range of the point cloud and the scale to normalize it
+ */
+void Polygon::computeRange() {
+    min[0] = min[1] = min[2] =  FLT_MAX;
+    max[0] = max[1] = max[2] = -FLT_MAX;
+    for_each(cloudWithNormals->begin(), cloudWithNormals->end(), [&](const pcl::PointXYZRGBNormal& pt) {
+        const float pos[] = { pt.x, pt.y, pt.z };
+        for (int i = 0; i < 3; i++) {
+            if (min[i] > pos[i]) {
+                min[i] = pos[i];
+            }
+            if (max[i] < pos[i]) {
+                max[i] = pos[i];
+            }
+        }
+    });
     float sub[] = { max[0]-min[0], max[1]-min[1], max[2]-min[2] };
     scl = (sub[0] > sub[1] ? sub[0] : (sub[1] > sub[2] ? sub[1] : sub[2]));
+}
+
+/**
+ * Construct the polygon mesh of the point cloud
+ * The normal vectors are estimated, then the point cloud is triangulated
+ * and decimated to the levels of detail.
+ */
+void Polygon::constructMesh() {
+    estimateNormals();
+    triangulateMesh();
+}
+
+/**
+ * Estimate the normal vectors of the point cloud
+ * The search tree and the point cloud with the outliers are released.
+ * @param frame context for the normal vectors, or null
+ */
+void Polygon::estimateNormals(FrameContext* ctx) {
+    if (!cloud) {
+        throw string("Point cloud is empty");
+    }
     // estimate normal vectors
+    // the outliers are kept in the search surface, but they have no normal vector
     pcl::NormalEstimation<pcl::PointXYZRGB, pcl::Normal> ne;
-    pcl::PointCloud<pcl::Normal>::Ptr normals(new pcl::PointCloud<pcl::Normal>);
-    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr cTree(new pcl::search::KdTree<pcl::PointXYZRGB>);
-    cTree->setInputCloud(cloud);
+    pcl::PointCloud<pcl::Normal>::Ptr normals;
+    if (ctx) {
+        normals = ctx->normals();
+    } else {
+        normals.reset(new pcl::PointCloud<pcl::Normal>);
+    }
     ne.setInputCloud(cloud);
+    if (inliers) {
+        ne.setIndices(inliers);
+    }
     ne.setSearchMethod(cTree);
     ne.setKSearch(20);
     ne.compute(*normals);
-    // concatenate the vertices and normal vectors
-    cloudWithNormals.reset(new pcl::PointCloud<pcl::PointXYZRGBNormal>);
-    pcl::concatenateFields(*cloud, *normals, *cloudWithNormals);
-    // triangulate
-    triangulate();
-    if (triangles->polygons.size() == 0) {
+    // set the normal vectors to the inliers
+    for (size_t i = 0; i < normals->size(); i++) {
+        pcl::PointXYZRGBNormal& pt = cloudWithNormals->points[i];
+        const pcl::Normal& n = normals->points[i];
+        pt.normal_x = n.normal_x;
+        pt.normal_y = n.normal_y;
+        pt.normal_z = n.normal_z;
+        pt.curvature = n.curvature;
+    }
+    // release the search tree and the point cloud with the outliers
+    cTree.reset();
+    inliers.reset();
+    cloud.reset();
+}
+
+/**
+ * Triangulate the point cloud with the normal vectors
+ * and decimate the polygon mesh to the levels of detail
+ * @param frame context for the search tree and the polygon mesh, or null
+ */
+void Polygon::triangulateMesh(FrameContext* ctx) {
+    if (!isValid() || cloud) {
+        throw string("Normal vectors are not estimated");
+    }
+    triangulate(ctx);
+    if (faceIdxs[0]->empty()) {
         throw string("Surface is empty");
     }
+    decimate();
+    if (ctx) {
+        // the vertex indexes of the levels of detail kept by the polygon
+        FrameContext::countUnpooled(faceIdxs.size() - 1);
+    }
+}
+
+/**
+ * Set the outlier removal filter
+ * Statistical: the point is removed if the mean distance to the nNbrs nearest
+ *              neighbors is larger than the global mean plus thresh times
+ *              the standard deviation.
+ * Radius:      the point is removed if it has less than nNbrs neighbors
+ *              in the thresh radius.
+ * @param type of the filter
+ * @param number of the neighbors
+ * @param standard deviation multiplier or radius
+ */
+void Polygon::setOutlierFilter(OutlierFilter flt, int nNbrs, double thresh) {
+    if (flt != OutlierFilter::None && (nNbrs < 1 || thresh <= 0.0)) {
+        throw string("Invalid outlier filter");
+    }
+    outlierFlt = flt;
+    outlierNbrs = nNbrs;
+    outlierThresh = thresh;
+}
+
+/**
+ * Set the number of the triangles at each level of detail
+ * The levels are generated by dividing the number of the triangles
+ * by the ratio repeatedly, if the numbers are empty.
+ * The numbers less than the minimum are ignored.
+ * @param numbers of the triangles
+ */
+void Polygon::setLevelsOfDetail(const vector<size_t>& nTris) {
+    lodTargets = nTris;
+}
+
+/**
+ * Remove the outliers of the point cloud
+ * The neighbors of the points are searched by the threads.
+ * @param point cloud
+ * @param search tree of the point cloud
+ * @param frame context for the work buffers and the indexes, or null
+ * @return indexes of the inliers, or null if the filter is disabled
+ */
+pcl::IndicesPtr Polygon::removeOutliers(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr& cloud,
+                                        const pcl::search::KdTree<pcl::PointXYZRGB>::Ptr& tree,
+                                        FrameContext* ctx) const {
+    pcl::IndicesPtr inliers;
+    if (outlierFlt == OutlierFilter::None) {
+        return inliers;
+    }
+    const size_t nPts = cloud->size();
+    vector<uchar> keepBuf;
+    vector<uchar>& keep = (ctx ? ctx->bytes("outliers.keep") : keepBuf);
+    keep.assign(nPts, 0);
+    if (outlierFlt == OutlierFilter::Statistical) {
+        // mean distance to the neighbors, the first neighbor is the point itself
+        vector<float> distBuf;
+        vector<float>& meanDists = (ctx ? ctx->floats("outliers.dists") : distBuf);
+        meanDists.assign(nPts, 0.0f);
+        Parallel::range(nPts, [&](size_t begin, size_t end) {
+            vector<int> idxs(outlierNbrs + 1);
+            vector<float> sqrDists(outlierNbrs + 1);
+            for (size_t i = begin; i < end; i++) {
+                int n = tree->nearestKSearch(cloud->points[i], outlierNbrs + 1, idxs, sqrDists);
+                double sum = 0.0;
+                for (int j = 1; j < n; j++) {
+                    sum += sqrt(sqrDists[j]);
+                }
+                meanDists[i] = (n > 1 ? (float)(sum / (double)(n - 1)) : FLT_MAX);
+            }
+        });
+        double sum = 0.0, sqrSum = 0.0;
+        size_t n = 0;
+        for_each(meanDists.begin(), meanDists.end(), [&](float dist) {
+            if (dist != FLT_MAX) {
+                sum += dist;
+                sqrSum += (double)dist * dist;
+                n++;
+            }
+        });
+        if (n == 0) {
+            return (ctx ? ctx->indices() : pcl::IndicesPtr(new vector<int>));
+        }
+        double mean = sum / (double)n;
+        double var = sqrSum / (double)n - mean * mean;
+        double thresh = mean + outlierThresh * sqrt(var > 0.0 ? var : 0.0);
+        for (size_t i = 0; i < nPts; i++) {
+            keep[i] = (meanDists[i] <= thresh ? 1 : 0);
+        }
+    } else {
+        // the search stops as soon as the enough neighbors are found
+        Parallel::range(nPts, [&](size_t begin, size_t end) {
+            vector<int> idxs;
+            vector<float> sqrDists;
+            for (size_t i = begin; i < end; i++) {
+                int n = tree->radiusSearch(cloud->points[i], outlierThresh, idxs, sqrDists, outlierNbrs + 1);
+                keep[i] = (n > outlierNbrs ? 1 : 0);
+            }
+        });
+    }
+    if (ctx) {
+        inliers = ctx->indices();
+    } else {
+        inliers.reset(new vector<int>);
+    }
+    inliers->reserve(nPts);
+    for (size_t i = 0; i < nPts; i++) {
+        if (keep[i]) {
+            inliers->push_back((int)i);
+        }
+    }
+    return inliers;
 }
 
 /**
  * Triangulate
+ * @param frame context for the search tree and the polygon mesh, or null
  */
-void Polygon::triangulate() {
+void Polygon::triangulate(FrameContext* ctx) {
+    TRACE_SCOPE("gp3");
     // create the search tree
-    pcl::search::KdTree<pcl::PointXYZRGBNormal>::Ptr cnTree(new pcl::search::KdTree<pcl::PointXYZRGBNormal>);
+    pcl::search::KdTree<pcl::PointXYZRGBNormal>::Ptr cnTree;
+    pcl::PolygonMesh::Ptr triangles;
+    if (ctx) {
+        cnTree = ctx->normalTree();
+        triangles = ctx->mesh();
+        // the index of the search tree and the vertex indexes kept by the polygon
+        FrameContext::countUnpooled(2);
+    } else {
+        cnTree.reset(new pcl::search::KdTree<pcl::PointXYZRGBNormal>);
+        triangles.reset(new pcl::PolygonMesh);
+    }
     cnTree->setInputCloud(cloudWithNormals);
     // initialize the objects
     pcl::GreedyProjectionTriangulation<pcl::PointXYZRGBNormal> gp3;
-    triangles.reset(new pcl::PolygonMesh);
     // set the typical values for the parameters
     gp3.setSearchRadius(searchRadius);
     gp3.setMu(mu);
@@ -143,5 +443,57 @@ void Polygon::triangulate() {
     gp3.setInputCloud(cloudWithNormals);
     gp3.setSearchMethod(cnTree);
     gp3.reconstruct(*triangles);
+    // flatten the vertex indexes of the triangles
+    // the polygon that has more than 3 vertices is split into the triangle fan
+    shared_ptr<vector<uint32_t>> faces(new vector<uint32_t>);
+    faces->reserve(triangles->polygons.size() * 3);
+    for_each(triangles->polygons.begin(), triangles->polygons.end(), [&](const pcl::Vertices& vtcs) {
+        const vector<uint32_t>& idxs = vtcs.vertices;
+        for (size_t i = 2; i < idxs.size(); i++) {
+            faces->push_back(idxs[0]);
+            faces->push_back(idxs[i-1]);
+            faces->push_back(idxs[i]);
+        }
+    });
+    faceIdxs.assign(1, faces);
+}
+
+/**
+ * Decimate the polygon mesh to the levels of detail
+ * The decimated meshes share the vertices of the original mesh.
+ * The level that has fewer triangles than the minimum is not generated.
+ */
+void Polygon::decimate() {
+    TRACE_SCOPE("decimate");
+    faceIdxs.resize(1);
+    const size_t nTris = faceIdxs[0]->size() / 3;
+    vector<size_t> nTargets;
+    if (lodTargets.empty()) {
+        size_t n = nTris;
+        for (int i = 0; i < NOFLODS; i++) {
+            n /= LODRATIO;
+            if (n < MINOFLODTRIS) {
+                break;
+            }
+            nTargets.push_back(n);
+        }
+    } else {
+        copy_if(lodTargets.begin(), lodTargets.end(), back_inserter(nTargets), [&](size_t n) {
+            return (n < nTris && n >= MINOFLODTRIS);
+        });
+    }
+    if (nTargets.empty()) {
+        return;
+    }
+    vector<float> pos;
+    pos.reserve(cloudWithNormals->size() * 3);
+    for_each(cloudWithNormals->begin(), cloudWithNormals->end(), [&](const pcl::PointXYZRGBNormal& pt) {
+        pos.push_back(pt.x);
+        pos.push_back(pt.y);
+        pos.push_back(pt.z);
+    });
+    Decimator decimator(pos, *faceIdxs[0]);
+    vector<shared_ptr<vector<uint32_t>>> lods = decimator.decimate(nTargets);
+    faceIdxs.insert(faceIdxs.end(), lods.begin(), lods.end());
 }
 
@@ -3,6 +3,13 @@
  *  - The 3D point cloud and the polygon mesh are implemented
  *    by Point Cloud Library (PCL).
  *  - The polygon mesh is constructed by pcl::GreedyProjectionTriangulation
+ *  - The outliers of the point cloud are removed before triangulating,
+ *    if the outlier removal filter is set.
+ *  - The polygon mesh is decimated to the levels of detail after triangulating.
+ *  - The point cloud is available before the polygon mesh is constructed.
+ *  - The polygon mesh constructed outside, such as by the fusion, is also set.
+ *  - The vertices with the normal vectors are available for the registration.
+ *  - The intermediate point clouds are kept in the frame context if it is given.
  * 
  * File:   Polygon.h
  * Author: munehiro
@@ -13,10 +20,12 @@
 #ifndef POLYGON_H
 #define	POLYGON_H
 
+#include <memory>
 #include <vector>
 #include <pcl-1.7/pcl/point_types.h>
 #include <pcl-1.7/pcl/point_cloud.h>
 #include <pcl-1.7/pcl/PolygonMesh.h>
+#include <pcl-1.7/pcl/search/kdtree.h>
 
 typedef unsigned char uchar;
 typedef unsigned int uint;
@@ -24,25 +33,67 @@ typedef unsigned int uint;
 using namespace std;
 
 class Vertex;
+class FrameContext;
 
 class Polygon {
 public:
+    // the type of the outlier removal filter
+    enum struct OutlierFilter : int {
+        None,           // no outlier is removed
+        Statistical,    // mean distance to the k nearest neighbors
+        Radius          // number of the neighbors in the radius
+    };
+    // default number of the neighbors and standard deviation multiplier of the statistical filter
+    static const int OUTLIERNBRS;
+    static const double OUTLIERTHRESH;
     Polygon();
     Polygon(const Polygon& orig);
     virtual ~Polygon();
     // verify whether the 3D point cloud is not empty
     bool isValid() const { return (cloudWithNormals && !cloudWithNormals->empty()); };
+    vector<Vertex> vertices() const;
     vector<Vertex> normalizedVertices() const;
-    vector<vector<uint>> faceVertexIndexes() const;
+    // get the number of the levels of detail, the level 0 is the original mesh
+    size_t nLevelsOfDetail() const { return faceIdxs.size(); };
+    shared_ptr<const vector<uint32_t>> faceIndexes(size_t lod = 0) const;
     void setVertices(const vector<Vertex>& vtcs);
+    void setPointCloud(const vector<Vertex>& vtcs, FrameContext* ctx = nullptr);
+    void setMesh(const vector<Vertex>& vtcs, const vector<uint32_t>& idxs);
+    void constructMesh();
+    void estimateNormals(FrameContext* ctx = nullptr);
+    void triangulateMesh(FrameContext* ctx = nullptr);
+    void setOutlierFilter(OutlierFilter flt, int nNbrs, double thresh);
+    void setLevelsOfDetail(const vector<size_t>& nTris);
 private:
-    void triangulate();
+    // default number of the levels of detail except the original mesh
+    // and the ratio of the number of the triangles between the levels
+    static const int NOFLODS, LODRATIO;
+    // minimum number of the triangles at the level of detail
+    static const size_t MINOFLODTRIS;
+    pcl::IndicesPtr removeOutliers(const pcl::PointCloud<pcl::PointXYZRGB>::Ptr& cloud,
+                                   const pcl::search::KdTree<pcl::PointXYZRGB>::Ptr& tree,
+                                   FrameContext* ctx) const;
+    void computeRange();
+    void triangulate(FrameContext* ctx);
+    void decimate();
+    // 3D point cloud with the outliers, its search tree and the indexes of the inliers,
+    // which are kept until the polygon mesh is constructed
+    pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud;
+    pcl::search::KdTree<pcl::PointXYZRGB>::Ptr cTree;
+    pcl::IndicesPtr inliers;
     // 3D point cloud
     pcl::PointCloud<pcl::PointXYZRGBNormal>::Ptr cloudWithNormals;
-    pcl::PolygonMesh::Ptr triangles;    // polygon mesh
+    // flat vertex indexes of the triangles at each level of detail
+    vector<shared_ptr<vector<uint32_t>>> faceIdxs;
+    vector<size_t> lodTargets;  // number of the triangles at each level of detail
     // the sphere radius to be used for triangulating
     // and the multiplier of the final search radius
     double searchRadius, mu;
+    // the type of the outlier removal filter,
+    // the number of the neighbors and the threshold of the filter
+    OutlierFilter outlierFlt;
+    int outlierNbrs;
+    double outlierThresh;
     // the minimum and the maximum range of x, y and z axis
     // and the scale to normalize the point cloud
     float min[3], max[3], scl;
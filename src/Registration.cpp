@@ -0,0 +1,251 @@
+/* 
+ * Registration Class
+ *  - The point cloud is aligned to the target point cloud
+ *    by the point-to-plane ICP, which uses the normal vectors of the target.
+ *  - The target is reduced to the centroid and the mean normal vector
+ *    of each cell of the uniform grid, whose cell is finer at each level.
+ *  - The correspondences are searched in the grid in parallel,
+ *    and rejected by the distance and the normal vectors.
+ *  - The source is subsampled coarse to fine, and the distance to accept
+ *    the correspondences is the cell of each level.
+ *  - The iterations at each level are terminated early
+ *    when the update of the pose or the change of the distances becomes small.
+ * 
+ * File:   Registration.cpp
+ * Author: munehiro
+ * 
+ * Created on October 19, 2026, 1:05 AM
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include "Registration.h"
+#include "Vertex.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+const int Registration::NOFLEVELS  = 3;
+const int Registration::COARSESTEP = 16;
+const int Registration::STEPRATIO  = 4;
+const int Registration::DISTRATIO  = 2;
+const int Registration::MAXITERS   = 30;
+const double Registration::EPSROTATION    = 1.0e-5;
+const double Registration::EPSTRANSLATION = 1.0e-3;
+const double Registration::EPSRMSE        = 1.0e-3;
+const double Registration::MINCOSINE      = 0.7;
+
+/**
+ * Constructor and Destructor
+ * The target points without the normal vectors are not used.
+ * @param target vertices with the normal vectors in millimeters
+ * @param distance to accept the correspondences at the coarsest level
+ */
+Registration::Registration(const vector<Vertex>& target, double maxDist) : nPts(0) {
+    TRACE_SCOPE("icp.grid");
+    if (maxDist <= 0.0) {
+        throw string("Invalid distance");
+    }
+    grids.resize(NOFLEVELS);
+    double cell = maxDist;
+    for (int l = 0; l < NOFLEVELS; l++, cell /= DISTRATIO) {
+        Grid& grid = grids[l];
+        grid.cell = cell;
+        grid.idxs.reserve(target.size() / 16);
+        vector<uint32_t> counts;
+        for_each(target.begin(), target.end(), [&](const Vertex& vtx) {
+            const double* p = vtx.position3d();
+            const double* n = vtx.normal3d();
+            double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (!isfinite(len) || len < 1.0e-6) {
+                return;
+            }
+            const cv::Vec3d pt(p[0], p[1], p[2]);
+            cv::Vec3d nml(n[0] / len, n[1] / len, n[2] / len);
+            auto it = grid.idxs.insert(make_pair(cellOf(pt, cell), (uint32_t)grid.pts.size()));
+            if (it.second) {
+                grid.pts.push_back(cv::Vec3d(0.0, 0.0, 0.0));
+                grid.nmls.push_back(cv::Vec3d(0.0, 0.0, 0.0));
+                counts.push_back(0);
+            }
+            // the signs of the normal vectors in the cell are aligned before they are averaged
+            uint32_t idx = it.first->second;
+            if (counts[idx] > 0 && grid.nmls[idx].dot(nml) < 0.0) {
+                nml = -nml;
+            }
+            grid.pts[idx] += pt;
+            grid.nmls[idx] += nml;
+            counts[idx]++;
+        });
+        for (size_t i = 0; i < grid.pts.size(); i++) {
+            grid.pts[i] = grid.pts[i] * (1.0 / counts[i]);
+            double len = cv::norm(grid.nmls[i]);
+            grid.nmls[i] = (len > 1.0e-6 ? grid.nmls[i] * (1.0 / len) : cv::Vec3d(0.0, 0.0, 0.0));
+        }
+        if (l == 0) {
+            for_each(counts.begin(), counts.end(), [&](uint32_t n) { nPts += n; });
+        }
+    }
+    if (nPts == 0) {
+        throw string("Normal vectors are not estimated");
+    }
+}
+
+Registration::~Registration() {
+}
+
+/**
+ * Align the source point cloud to the target point cloud
+ * @param source vertices in millimeters, whose normal vectors are used
+ *        to reject the correspondences if they are estimated
+ * @param initial pose from the source to the target
+ * @return result of the alignment
+ */
+Registration::Result Registration::align(const vector<Vertex>& source, const cv::Matx44d& guess) const {
+    TRACE_SCOPE("icp.align");
+    if (source.empty()) {
+        throw string("Point cloud is empty");
+    }
+    cv::Matx33d rot(guess(0, 0), guess(0, 1), guess(0, 2),
+                    guess(1, 0), guess(1, 1), guess(1, 2),
+                    guess(2, 0), guess(2, 1), guess(2, 2));
+    cv::Vec3d trn(guess(0, 3), guess(1, 3), guess(2, 3));
+    Result res;
+    res.rmse = 0.0;
+    res.fitness = 0.0;
+    res.nIters = 0;
+    res.isConverged = false;
+    mutex mtx;
+    size_t step = COARSESTEP;
+    for (int l = 0; l < NOFLEVELS; l++, step = max<size_t>(1, step / STEPRATIO)) {
+        const Grid& grid = grids[l];
+        const size_t nSamples = (source.size() + step - 1) / step;
+        double prevRmse = -1.0;
+        for (int iter = 0; iter < MAXITERS; iter++) {
+            // the normal equations of the point-to-plane distances linearized around the pose
+            double ata[6][6] = { { 0.0 } }, atb[6] = { 0.0 }, sse = 0.0;
+            size_t nCorrs = 0;
+            Parallel::range(nSamples, [&](size_t begin, size_t end) {
+                double a[6][6] = { { 0.0 } }, b[6] = { 0.0 }, e = 0.0;
+                size_t n = 0;
+                for (size_t i = begin; i < end; i++) {
+                    const Vertex& vtx = source[i * step];
+                    const double* sp = vtx.position3d();
+                    const double* sn = vtx.normal3d();
+                    const cv::Vec3d p = rot * cv::Vec3d(sp[0], sp[1], sp[2]) + trn;
+                    int j = nearest(grid, p);
+                    if (j < 0) {
+                        continue;
+                    }
+                    const cv::Vec3d& nml = grid.nmls[j];
+                    const cv::Vec3d srcNml = rot * cv::Vec3d(sn[0], sn[1], sn[2]);
+                    double len = cv::norm(srcNml);
+                    if (len > 1.0e-6 && fabs(srcNml.dot(nml)) < MINCOSINE * len) {
+                        continue;
+                    }
+                    const double r = (p - grid.pts[j]).dot(nml);
+                    const cv::Vec3d c = p.cross(nml);
+                    const double jac[] = { c[0], c[1], c[2], nml[0], nml[1], nml[2] };
+                    for (int u = 0; u < 6; u++) {
+                        for (int v = u; v < 6; v++) {
+                            a[u][v] += jac[u] * jac[v];
+                        }
+                        b[u] -= jac[u] * r;
+                    }
+                    e += r * r;
+                    n++;
+                }
+                lock_guard<mutex> lock(mtx);
+                for (int u = 0; u < 6; u++) {
+                    for (int v = u; v < 6; v++) {
+                        ata[u][v] += a[u][v];
+                    }
+                    atb[u] += b[u];
+                }
+                sse += e;
+                nCorrs += n;
+            }, 256);
+            if (nCorrs < 6) {
+                throw string("Too few correspondences");
+            }
+            for (int u = 0; u < 6; u++) {
+                for (int v = 0; v < u; v++) {
+                    ata[u][v] = ata[v][u];
+                }
+            }
+            res.rmse = sqrt(sse / nCorrs);
+            res.fitness = (double)nCorrs / nSamples;
+            res.nIters++;
+            if (prevRmse >= 0.0 && fabs(prevRmse - res.rmse) <= EPSRMSE * prevRmse) {
+                res.isConverged = (l == NOFLEVELS - 1);
+                break;
+            }
+            prevRmse = res.rmse;
+            // update the pose by the small rotation and translation
+            const cv::Vec6d x = cv::Matx66d(&ata[0][0]).solve(cv::Vec6d(atb), cv::DECOMP_CHOLESKY);
+            const cv::Vec3d omega(x[0], x[1], x[2]), dt(x[3], x[4], x[5]);
+            cv::Matx33d dr;
+            cv::Rodrigues(omega, dr);
+            rot = dr * rot;
+            trn = dr * trn + dt;
+            if (cv::norm(omega) < EPSROTATION && cv::norm(dt) < EPSTRANSLATION) {
+                res.isConverged = (l == NOFLEVELS - 1);
+                break;
+            }
+        }
+    }
+    res.pose = cv::Matx44d(rot(0, 0), rot(0, 1), rot(0, 2), trn[0],
+                           rot(1, 0), rot(1, 1), rot(1, 2), trn[1],
+                           rot(2, 0), rot(2, 1), rot(2, 2), trn[2],
+                           0.0, 0.0, 0.0, 1.0);
+    return res;
+}
+
+/**
+ * Get the key of the cell that contains the point
+ * @param point
+ * @param size of the cell
+ * @param offset of the cell in x
+ * @param offset of the cell in y
+ * @param offset of the cell in z
+ * @return key of the cell
+ */
+uint64_t Registration::cellOf(const cv::Vec3d& pt, double cell, int dx, int dy, int dz) const {
+    const int64_t ofs = 1 << 20, mask = (1 << 21) - 1;
+    const int64_t x = (int64_t)floor(pt[0] / cell) + dx + ofs;
+    const int64_t y = (int64_t)floor(pt[1] / cell) + dy + ofs;
+    const int64_t z = (int64_t)floor(pt[2] / cell) + dz + ofs;
+    return (uint64_t)(x & mask) << 42 | (uint64_t)(y & mask) << 21 | (uint64_t)(z & mask);
+}
+
+/**
+ * Search the nearest target point within the cell of the grid
+ * The centroids of the 8 cells on the nearer side of each axis are compared,
+ * which cover the half cell around the point.
+ * @param grid
+ * @param point
+ * @return index of the target point in the grid, or -1 if not found
+ */
+int Registration::nearest(const Grid& grid, const cv::Vec3d& pt) const {
+    int side[3];
+    for (int j = 0; j < 3; j++) {
+        double c = pt[j] / grid.cell;
+        side[j] = (c - floor(c) < 0.5 ? -1 : 1);
+    }
+    int idx = -1;
+    double minD2 = grid.cell * grid.cell;
+    for (int k = 0; k < 8; k++) {
+        uint64_t key = cellOf(pt, grid.cell, (k & 1 ? side[0] : 0), (k & 2 ? side[1] : 0), (k & 4 ? side[2] : 0));
+        auto it = grid.idxs.find(key);
+        if (it == grid.idxs.end()) {
+            continue;
+        }
+        const cv::Vec3d d = grid.pts[it->second] - pt;
+        double d2 = d.dot(d);
+        if (d2 < minD2 && grid.nmls[it->second].dot(grid.nmls[it->second]) > 0.0) {
+            minD2 = d2;
+            idx = (int)it->second;
+        }
+    }
+    return idx;
+}
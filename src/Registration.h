@@ -0,0 +1,73 @@
+/* 
+ * Registration Class
+ *  - The point cloud is aligned to the target point cloud
+ *    by the point-to-plane ICP, which uses the normal vectors of the target.
+ *  - The target is reduced to the centroid and the mean normal vector
+ *    of each cell of the uniform grid, whose cell is finer at each level.
+ *  - The correspondences are searched in the grid in parallel,
+ *    and rejected by the distance and the normal vectors.
+ *  - The source is subsampled coarse to fine, and the distance to accept
+ *    the correspondences is the cell of each level.
+ *  - The iterations at each level are terminated early
+ *    when the update of the pose or the change of the distances becomes small.
+ * 
+ * File:   Registration.h
+ * Author: munehiro
+ * 
+ * Created on October 19, 2026, 1:05 AM
+ */
+
+#ifndef REGISTRATION_H
+#define	REGISTRATION_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+class Vertex;
+
+class Registration {
+public:
+    // the result of the alignment
+    struct Result {
+        cv::Matx44d pose;   // pose from the source to the target
+        double rmse;        // root mean square of the point-to-plane distances
+        double fitness;     // ratio of the source points that have the correspondences
+        int nIters;         // number of the iterations of all levels
+        bool isConverged;   // the finest level is terminated early or not
+    };
+    Registration(const vector<Vertex>& target, double maxDist = 20.0);
+    virtual ~Registration();
+    // get the number of the target points with the normal vectors
+    size_t nTargets() const { return nPts; };
+    Result align(const vector<Vertex>& source, const cv::Matx44d& guess = cv::Matx44d::eye()) const;
+private:
+    // number of the levels, the subsampling step of the source at the coarsest level,
+    // the ratio of the steps and the ratio of the distances between the levels
+    static const int NOFLEVELS, COARSESTEP, STEPRATIO, DISTRATIO;
+    // maximum number of the iterations at each level
+    static const int MAXITERS;
+    // rotation in radians and translation in millimeters to terminate the iterations,
+    // and the relative change of the root mean square distance to terminate them
+    static const double EPSROTATION, EPSTRANSLATION, EPSRMSE;
+    // minimum cosine between the normal vectors of the correspondence
+    static const double MINCOSINE;
+    // the uniform grid of the target points
+    struct Grid {
+        double cell;                // size of the cell, which is the distance to accept the correspondences
+        unordered_map<uint64_t, uint32_t> idxs;     // index of the point of each cell
+        vector<cv::Vec3d> pts;      // centroids of the cells
+        vector<cv::Vec3d> nmls;     // mean unit normal vectors of the cells
+    };
+    uint64_t cellOf(const cv::Vec3d& pt, double cell, int dx = 0, int dy = 0, int dz = 0) const;
+    int nearest(const Grid& grid, const cv::Vec3d& pt) const;
+    size_t nPts;                // number of the target points with the normal vectors
+    vector<Grid> grids;         // grids of each level, the first is the coarsest
+
+};
+
+#endif	/* REGISTRATION_H */
+
@@ -0,0 +1,132 @@
+/* 
+ * RenderStats Class
+ *  - The statistics of rendering the scene are collected,
+ *    such as the frame time, the time and the number of the primitives
+ *    of each layer, the time to update and upload the model,
+ *    and the peak memory of the process.
+ *  - The statistics are written to the log stream
+ *    and formatted to the text of the overlay.
+ *  - Nothing is measured while the statistics are disabled.
+ * 
+ * File:   RenderStats.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 5:20 PM
+ */
+
+#include <iomanip>
+#include <sstream>
+#include "RenderStats.h"
+#include "MemoryStats.h"
+
+const char* RenderStats::LAYERNAMES[NOFLAYERS] = { "points", "edges", "surface" };
+
+/**
+ * Constructor and Destructor
+ */
+RenderStats::RenderStats() : enabled(false), log(nullptr), start(0.0), frmMsec(0.0)
+, nVtcs(0), nTris(0), updateMsec(0.0), uploadMsec(0.0) {
+    for (int i = 0; i < NOFLAYERS; i++) {
+        layerMsec[i] = 0.0;
+        nPrims[i] = 0;
+    }
+}
+
+RenderStats::~RenderStats() {
+}
+
+/**
+ * Enable or disable the statistics
+ * @param enabled or not
+ * @param log stream, or null not to write the log
+ */
+void RenderStats::setEnabled(bool enabled, ostream* log) {
+    this->enabled = enabled;
+    this->log = (enabled ? log : nullptr);
+}
+
+/**
+ * Begin the frame
+ */
+void RenderStats::beginFrame() {
+    start = now();
+}
+
+/**
+ * End the frame
+ * The statistics of the frame are written to the log.
+ */
+void RenderStats::endFrame() {
+    frmMsec = now() - start;
+    if (log) {
+        *log << fixed << setprecision(2) << "frame " << frmMsec << " ms";
+        for (int i = 0; i < NOFLAYERS; i++) {
+            *log << ", " << LAYERNAMES[i] << " " << layerMsec[i] << " ms (" << nPrims[i] << ")";
+        }
+        *log << endl;
+    }
+}
+
+/**
+ * Set the statistics of the layer
+ * The layer keeps the statistics until it is rendered again,
+ * while the cached scene is copied to the window.
+ * @param index of the layer
+ * @param time to render the layer in milliseconds
+ * @param number of the primitives rendered
+ */
+void RenderStats::setLayer(int layer, double msec, size_t nPrims) {
+    layerMsec[layer] = msec;
+    this->nPrims[layer] = nPrims;
+}
+
+/**
+ * Set the time to update the model
+ * @param time in milliseconds
+ */
+void RenderStats::setUpdate(double msec) {
+    updateMsec = msec;
+}
+
+/**
+ * Set the statistics of uploading the model
+ * @param number of the vertices
+ * @param number of the triangles
+ * @param time to upload the model in milliseconds
+ */
+void RenderStats::setUpload(size_t nVtcs, size_t nTris, double msec) {
+    this->nVtcs = nVtcs;
+    this->nTris = nTris;
+    uploadMsec = msec;
+    if (log) {
+        *log << fixed << setprecision(2) << "model " << nVtcs << " vertices, " << nTris << " triangles"
+             << ", update " << updateMsec << " ms, upload " << uploadMsec << " ms" << endl;
+    }
+}
+
+/**
+ * Format the statistics to the lines of the text
+ * @return lines of the text
+ */
+vector<string> RenderStats::lines() const {
+    vector<string> lns;
+    ostringstream ss;
+    ss << fixed << setprecision(2) << "frame: " << frmMsec << " ms";
+    lns.push_back(ss.str());
+    for (int i = 0; i < NOFLAYERS; i++) {
+        ss.str("");
+        ss << LAYERNAMES[i] << ": " << layerMsec[i] << " ms, " << nPrims[i];
+        lns.push_back(ss.str());
+    }
+    ss.str("");
+    ss << "vertices: " << nVtcs << ", triangles: " << nTris;
+    lns.push_back(ss.str());
+    ss.str("");
+    ss << "update: " << updateMsec << " ms, upload: " << uploadMsec << " ms";
+    lns.push_back(ss.str());
+    ss.str("");
+    ss << "peak RSS: " << MemoryStats::format((double)MemoryStats::peakResidentBytes());
+    lns.push_back(ss.str());
+    return lns;
+}
+
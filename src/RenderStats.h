@@ -0,0 +1,61 @@
+/* 
+ * RenderStats Class
+ *  - The statistics of rendering the scene are collected,
+ *    such as the frame time, the time and the number of the primitives
+ *    of each layer, the time to update and upload the model,
+ *    and the peak memory of the process.
+ *  - The statistics are written to the log stream
+ *    and formatted to the text of the overlay.
+ *  - Nothing is measured while the statistics are disabled.
+ * 
+ * File:   RenderStats.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 5:20 PM
+ */
+
+#ifndef RENDERSTATS_H
+#define	RENDERSTATS_H
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class RenderStats {
+public:
+    // number of the layers
+    static const int NOFLAYERS = 3;
+    // names of the layers
+    static const char* LAYERNAMES[NOFLAYERS];
+    RenderStats();
+    virtual ~RenderStats();
+    // verify whether the statistics are collected
+    bool isEnabled() const { return enabled; };
+    void setEnabled(bool enabled, ostream* log = nullptr);
+    // get the current time in milliseconds
+    static double now() {
+        return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    void beginFrame();
+    void endFrame();
+    void setLayer(int layer, double msec, size_t nPrims);
+    void setUpdate(double msec);
+    void setUpload(size_t nVtcs, size_t nTris, double msec);
+    vector<string> lines() const;
+private:
+    bool enabled;           // the statistics are collected or not
+    ostream* log;           // log stream, or null
+    double start;           // time when the frame is begun
+    double frmMsec;         // time to render the last frame
+    double layerMsec[NOFLAYERS];    // time to render each layer when the scene is rendered last
+    size_t nPrims[NOFLAYERS];       // number of the primitives rendered in each layer
+    size_t nVtcs, nTris;    // number of the vertices and the triangles of the model
+    double updateMsec, uploadMsec;  // time to update and upload the model
+
+};
+
+#endif	/* RENDERSTATS_H */
+
@@ -6,6 +6,15 @@
  *  - The 3D point cloud, the edges and surfaces of the 3D polygon are rendered.
  *  - The 3D polygon is rotated by the mouse drag.
  *  - The 3D polygon is zoomed in/out by the mouse wheel.
+ *  - The level of detail of the 3D polygon is selectable.
+ *  - The vertices and the indexes are uploaded to the buffer objects
+ *    when the model is updated, and rendered by the indexed draw calls.
+ *  - The scene is rendered only when it is changed,
+ *    at most once per frame interval, and cached in the frame buffer object.
+ *  - The point cloud is divided by the octree, the nodes out of the view are culled
+ *    and the points are subsampled under the budget while the polygon is moving.
+ *  - The render statistics are shown in the overlay and written to the log.
+ *  - The point cloud is rendered before the polygon mesh is constructed.
  * 
  * File:   SceneView.cpp
  * Author: munehiro
@@ -13,10 +22,16 @@
  * Created on March 1, 2014, 7:35 PM
  */
 
+#define GL_GLEXT_PROTOTYPES
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
 #include "SceneView.h"
 #include "GraphicsModel.h"
 #include "Polygon.h"
 #include "Vertex.h"
+#include "Octree.h"
+#include "Trace.h"
 extern "C" {
     #include "trackball.h"
 }
@@ -24,12 +39,22 @@ extern "C" {
 const GLdouble SceneView::EYEPOINT = 30.0;
 const GLdouble SceneView::NEARCLIP = EYEPOINT - 10.0;
 const GLdouble SceneView::FARCLIP  = EYEPOINT + 10.0;
+const unsigned int SceneView::FRAMEINTERVAL = 16;
+const unsigned int SceneView::REFINEDELAY = 200;
+const GLsizei SceneView::POINTBUDGET = 1000000;
+const char* SceneView::OVERLAYFONT = "Monospace 9";
+const GLint SceneView::LINEHEIGHT = 14;
 
 /**
  * Constructor and Destructor
  */
-SceneView::SceneView() : mx(0.0f), my(0.0f), scl(1.0) {
+SceneView::SceneView() : mx(0.0f), my(0.0f), scl(1.0), lod(0)
+, vtxDirty(false), idxDirty(false), vtxBuf(0), faceBuf(0), edgeBuf(0)
+, nVtcs(0), nFaceIdxs(0), nEdgeIdxs(0), sceneDirty(true)
+, frameBuf(0), colorBuf(0), depthBuf(0), frameBufSupported(false)
+, pointBuf(0), pointBudget(POINTBUDGET), moving(false), viewW(1.0), viewH(1.0), fontBase(0) {
     currQ[0] = 0.0f; currQ[1] = 0.0f; currQ[2] = 0.0f; currQ[3] = 1.0f;
+    visible[0] = visible[1] = visible[2] = true;
     
     Glib::RefPtr<Gdk::GL::Config> config = Gdk::GL::Config::create(Gdk::GL::MODE_RGB   |
                                                                    Gdk::GL::MODE_DEPTH |
@@ -48,21 +73,236 @@ SceneView::SceneView() : mx(0.0f), my(0.0f), scl(1.0) {
 }
 
 SceneView::~SceneView() {
+    frameConn.disconnect();
+    refineConn.disconnect();
 }
 
 /**
  * Update the scene view
+ * The point cloud is copied only when it is changed,
+ * and only the indexes of the surfaces are copied when the polygon mesh is changed.
  * @param subject
+ * @param mask of the changes
  */
-void SceneView::update(const Subject* subject) {
-    vtcs.clear();
-    Polygon* ply = ((GraphicsModel*)subject)->polygon();
+void SceneView::update(const Subject* subject, unsigned int changes) {
+    const GraphicsModel* model = (const GraphicsModel*)subject;
+    Polygon* ply = model->polygon();
+    if (!(changes & (GraphicsModel::CloudChanged | GraphicsModel::MeshChanged))) {
+        return;
+    }
+    if (!(changes & GraphicsModel::CloudChanged)) {
+        // the point cloud is already uploaded, then only the polygon mesh is updated
+        lodIdxs.clear();
+        for (size_t i = 0; ply && i < ply->nLevelsOfDetail(); i++) {
+            lodIdxs.push_back(ply->faceIndexes(i));
+        }
+        setLevelOfDetail(lod);
+        return;
+    }
+    double start = (stats.isEnabled() ? RenderStats::now() : 0.0);
+    positions.clear();
+    colors.clear();
+    lodIdxs.clear();
+    octree.reset();
     if (ply && ply->isValid()) {
         // get the point cloud and the indexes of the polygon surfaces
-        vtcs = ply->normalizedVertices();
-        faceVtxIdxs = ply->faceVertexIndexes();
+        vector<Vertex> vtcs = ply->normalizedVertices();
+        positions.reserve(vtcs.size() * 3);
+        colors.reserve(vtcs.size() * 3);
+        for_each(vtcs.begin(), vtcs.end(), [&](const Vertex& vtx) {
+            const double* pos = vtx.position3d();
+            const uchar* col = vtx.color3b();
+            positions.insert(positions.end(), { (GLfloat)pos[0], (GLfloat)pos[1], (GLfloat)pos[2] });
+            colors.insert(colors.end(), { col[0], col[1], col[2] });
+        });
+        for (size_t i = 0; i < ply->nLevelsOfDetail(); i++) {
+            lodIdxs.push_back(ply->faceIndexes(i));
+        }
+        octree.reset(new Octree(positions));
+    }
+    if (stats.isEnabled()) {
+        stats.setUpdate(RenderStats::now() - start);
+    }
+    vtxDirty = true;
+    setLevelOfDetail(lod);
+    // the point cloud is rendered before the polygon mesh is constructed
+    if (!model->isComplete() && is_realized()) {
+        onFrame();
+        get_window()->process_updates(false);
+    }
+}
+
+/**
+ * Set the level of detail of the polygon surfaces
+ * @param level of detail, the coarsest level is used if it is out of range
+ */
+void SceneView::setLevelOfDetail(size_t lod) {
+    this->lod = lod;
+    faceIdxs.reset();
+    if (!lodIdxs.empty()) {
+        faceIdxs = lodIdxs[lod < lodIdxs.size() ? lod : lodIdxs.size() - 1];
+    }
+    idxDirty = true;
+    if (is_realized()) {
+        upload();
+    }
+    invalidate();
+}
+
+/**
+ * Show or hide the layer
+ * @param layer
+ * @param visible or not
+ */
+void SceneView::setLayerVisible(Layer layer, bool visible) {
+    if (this->visible[(int)layer] != visible) {
+        this->visible[(int)layer] = visible;
+        invalidate();
+    }
+}
+
+/**
+ * Show or hide the render statistics
+ * The statistics are measured only while they are shown,
+ * and the layers are finished one by one to measure the time of each layer.
+ * @param shown or not
+ * @param log stream of the statistics, or null not to write the log
+ */
+void SceneView::setStatsEnabled(bool enabled, ostream* log) {
+    stats.setEnabled(enabled, log);
+    invalidate();
+}
+
+/**
+ * Set the maximum number of the points rendered while the polygon is moving
+ * @param number of the points
+ */
+void SceneView::setPointBudget(GLsizei budget) {
+    pointBudget = (budget > 0 ? budget : 1);
+    invalidate();
+}
+
+/**
+ * Invalidate the cached scene
+ * The changes until the next frame are rendered at once.
+ */
+void SceneView::invalidate() {
+    sceneDirty = true;
+    if (!frameConn.connected()) {
+        frameConn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &SceneView::onFrame), FRAMEINTERVAL);
+    }
+}
+
+/**
+ * On frame timeout
+ * @return false to disconnect the timeout
+ */
+bool SceneView::onFrame() {
+    if (is_realized()) {
         get_window()->invalidate_rect(get_allocation(), false);
     }
+    return false;
+}
+
+/**
+ * Move the polygon
+ * The point cloud is subsampled until the polygon stops.
+ */
+void SceneView::move() {
+    moving = true;
+    refineConn.disconnect();
+    refineConn = Glib::signal_timeout().connect(sigc::mem_fun(*this, &SceneView::onRefine), REFINEDELAY);
+    invalidate();
+}
+
+/**
+ * On refine timeout
+ * @return false to disconnect the timeout
+ */
+bool SceneView::onRefine() {
+    moving = false;
+    invalidate();
+    return false;
+}
+
+/**
+ * Upload the vertices and the indexes to the buffer objects
+ * The vertices are released after uploading.
+ */
+void SceneView::upload() {
+    Glib::RefPtr<Gdk::GL::Drawable> drawable = get_gl_drawable();
+    if (!drawable->gl_begin(get_gl_context())) {
+        return;
+    }
+    bool dirty = (vtxDirty || idxDirty);
+    double start = (stats.isEnabled() ? RenderStats::now() : 0.0);
+    if (vtxDirty) {
+        // the colors follow the positions in the same buffer object
+        if (!vtxBuf) {
+            glGenBuffers(1, &vtxBuf);
+        }
+        nVtcs = positions.size() / 3;
+        GLsizeiptr posSize = positions.size() * sizeof(GLfloat);
+        GLsizeiptr colSize = colors.size() * sizeof(GLubyte);
+        glBindBuffer(GL_ARRAY_BUFFER, vtxBuf);
+        glBufferData(GL_ARRAY_BUFFER, posSize + colSize, nullptr, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, posSize, positions.data());
+        glBufferSubData(GL_ARRAY_BUFFER, posSize, colSize, colors.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (!pointBuf) {
+            glGenBuffers(1, &pointBuf);
+        }
+        const vector<uint32_t>* order = (octree ? &octree->order() : nullptr);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pointBuf);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (order ? order->size() : 0) * sizeof(GLuint),
+                (order ? order->data() : nullptr), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        vector<GLfloat>().swap(positions);
+        vector<GLubyte>().swap(colors);
+        vtxDirty = false;
+    }
+    if (idxDirty) {
+        if (!faceBuf) {
+            glGenBuffers(1, &faceBuf);
+            glGenBuffers(1, &edgeBuf);
+        }
+        // the edge that is shared by the triangles is listed once
+        vector<uint64_t> edges;
+        if (faceIdxs) {
+            const vector<uint32_t>& idxs = *faceIdxs;
+            edges.reserve(idxs.size());
+            for (size_t i = 0; i + 2 < idxs.size(); i += 3) {
+                for (int j = 0; j < 3; j++) {
+                    uint64_t a = idxs[i+j];
+                    uint64_t b = idxs[i+(j+1)%3];
+                    edges.push_back(a < b ? (a << 32 | b) : (b << 32 | a));
+                }
+            }
+            sort(edges.begin(), edges.end());
+            edges.erase(unique(edges.begin(), edges.end()), edges.end());
+        }
+        vector<GLuint> edgeIdxs;
+        edgeIdxs.reserve(edges.size() * 2);
+        for_each(edges.begin(), edges.end(), [&](uint64_t edge) {
+            edgeIdxs.push_back((GLuint)(edge >> 32));
+            edgeIdxs.push_back((GLuint)(edge & 0xffffffff));
+        });
+        nFaceIdxs = (faceIdxs ? faceIdxs->size() / 3 * 3 : 0);
+        nEdgeIdxs = edgeIdxs.size();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceBuf);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, nFaceIdxs * sizeof(GLuint),
+                (faceIdxs ? faceIdxs->data() : nullptr), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuf);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, nEdgeIdxs * sizeof(GLuint),
+                edgeIdxs.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        idxDirty = false;
+    }
+    if (dirty && stats.isEnabled()) {
+        glFinish();
+        stats.setUpload(nVtcs, nFaceIdxs / 3, RenderStats::now() - start);
+    }
+    drawable->gl_end();
 }
 
 /**
@@ -79,7 +319,34 @@ void SceneView::on_realize() {
     glDisable(GL_LIGHTING); // disable lighting
     glEnable(GL_DEPTH_TEST);
     glShadeModel(GL_SMOOTH);
+    // the frame buffer object is in the core since OpenGL 3.0
+    const char* version = (const char*)glGetString(GL_VERSION);
+    frameBufSupported = ((version && atoi(version) >= 3) ||
+                         Gdk::GL::query_gl_extension("GL_ARB_framebuffer_object"));
     drawable->gl_end();
+    // upload the model that is updated before realizing
+    upload();
+}
+
+/**
+ * On unrealize
+ */
+void SceneView::on_unrealize() {
+    Glib::RefPtr<Gdk::GL::Drawable> drawable = get_gl_drawable();
+    if (drawable && drawable->gl_begin(get_gl_context())) {
+        GLuint bufs[] = { vtxBuf, faceBuf, edgeBuf, pointBuf };
+        glDeleteBuffers(4, bufs);
+        resizeFrameBuffer(0, 0);
+        if (fontBase) {
+            glDeleteLists(fontBase, 128);
+        }
+        drawable->gl_end();
+    }
+    frameConn.disconnect();
+    refineConn.disconnect();
+    vtxBuf = faceBuf = edgeBuf = pointBuf = fontBase = 0;
+    nVtcs = nFaceIdxs = nEdgeIdxs = 0;
+    Gtk::DrawingArea::on_unrealize();
 }
 
 /**
@@ -100,26 +367,105 @@ bool SceneView::on_configure_event(GdkEventConfigure* event) {
     // orthogonal view
     GLdouble aspect = (GLdouble)w / (GLdouble)h;
     if (h < w) {
-        glOrtho(-aspect, aspect, -1.0, 1.0, NEARCLIP, FARCLIP);
+        viewW = aspect;
+        viewH = 1.0;
     } else {
-        aspect = 1.0 / aspect;
-        glOrtho(-1.0, 1.0, -aspect, aspect, NEARCLIP, FARCLIP);
+        viewW = 1.0;
+        viewH = 1.0 / aspect;
     }
+    glOrtho(-viewW, viewW, -viewH, viewH, NEARCLIP, FARCLIP);
     glMatrixMode(GL_MODELVIEW);
+    resizeFrameBuffer(w, h);
     drawable->gl_end();
+    sceneDirty = true;
     return true;
 }
 
+/**
+ * Resize the frame buffer object to cache the scene
+ * The scene is rendered to the window directly,
+ * if the frame buffer object is not supported by the context, which is checked on realize.
+ * @param width, or 0 to release the frame buffer object
+ * @param height
+ */
+void SceneView::resizeFrameBuffer(GLsizei w, GLsizei h) {
+    if (frameBuf) {
+        glDeleteFramebuffers(1, &frameBuf);
+        GLuint bufs[] = { colorBuf, depthBuf };
+        glDeleteRenderbuffers(2, bufs);
+        frameBuf = colorBuf = depthBuf = 0;
+    }
+    if (w <= 0 || h <= 0 || !frameBufSupported) {
+        return;
+    }
+    glGenFramebuffers(1, &frameBuf);
+    glGenRenderbuffers(1, &colorBuf);
+    glGenRenderbuffers(1, &depthBuf);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuf);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuf);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuf);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuf);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuf);
+    bool complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        resizeFrameBuffer(0, 0);
+    }
+}
+
 /**
  * On expose event
+ * The cached scene is copied to the window if the scene is not changed.
  * @param event
  * @return 
  */
 bool SceneView::on_expose_event(GdkEventExpose* event) {
+    TRACE_SCOPE("scene.expose");
     Glib::RefPtr<Gdk::GL::Drawable> drawable = get_gl_drawable();
     if (!drawable->gl_begin(get_gl_context())) {
         return false;
     }
+    frameConn.disconnect();
+    if (stats.isEnabled()) {
+        stats.beginFrame();
+    }
+    if (frameBuf) {
+        GLsizei w = get_width();
+        GLsizei h = get_height();
+        if (sceneDirty) {
+            glBindFramebuffer(GL_FRAMEBUFFER, frameBuf);
+            renderScene();
+            sceneDirty = false;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuf);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    } else {
+        renderScene();
+        sceneDirty = false;
+    }
+    if (stats.isEnabled()) {
+        glFinish();
+        stats.endFrame();
+        renderOverlay();
+    }
+    if (drawable->is_double_buffered()) {
+        drawable->swap_buffers();
+    } else {
+        glFlush();
+    }
+    drawable->gl_end();
+    return true;
+}
+
+/**
+ * Render the visible layers of the scene to the current frame buffer
+ */
+void SceneView::renderScene() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
     glPushMatrix();
@@ -130,18 +476,85 @@ bool SceneView::on_expose_event(GdkEventExpose* event) {
     glMultMatrixf(&m[0][0]);            // rotate the polygon
     
     // render the point cloud, the polygon edges and surfaces
-    renderPointCloud();
-    renderEdges();
-    renderSurface();
+    if (vtxBuf && nVtcs > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, vtxBuf);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, (const GLvoid*)0);
+        glColorPointer(3, GL_UNSIGNED_BYTE, 0, (const GLvoid*)(nVtcs * 3 * sizeof(GLfloat)));
+        renderLayer(Layer::PointCloud, &SceneView::renderPointCloud);
+        renderLayer(Layer::Edges, &SceneView::renderEdges);
+        renderLayer(Layer::Surface, &SceneView::renderSurface);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
     glPopMatrix();
-    if (drawable->is_double_buffered()) {
-        drawable->swap_buffers();
-    } else {
-        glFlush();
+}
+
+/**
+ * Render the layer if it is visible
+ * The time and the number of the primitives are measured
+ * while the render statistics are enabled.
+ * @param layer
+ * @param member function to render the layer
+ */
+void SceneView::renderLayer(Layer layer, GLsizei (SceneView::*render)()) {
+    TRACE_SCOPE("scene.layer");
+    if (!visible[(int)layer]) {
+        if (stats.isEnabled()) {
+            stats.setLayer((int)layer, 0.0, 0);
+        }
+        return;
     }
-    drawable->gl_end();
-    return true;
+    if (!stats.isEnabled()) {
+        (this->*render)();
+        return;
+    }
+    glFinish();
+    double start = RenderStats::now();
+    GLsizei nPrims = (this->*render)();
+    glFinish();
+    stats.setLayer((int)layer, RenderStats::now() - start, nPrims);
+}
+
+/**
+ * Render the overlay of the render statistics to the window
+ * The overlay is not cached, then the statistics are rendered in every frame.
+ */
+void SceneView::renderOverlay() {
+    if (!fontBase) {
+        fontBase = glGenLists(128);
+        if (!Gdk::GL::Font::use_pango_font(Pango::FontDescription(OVERLAYFONT), 0, 128, fontBase)) {
+            glDeleteLists(fontBase, 128);
+            fontBase = 0;
+            return;
+        }
+    }
+    GLint w = get_width();
+    GLint h = get_height();
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LIST_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0, w, 0.0, h, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glColor3f(1.0f, 1.0f, 0.0f);
+    glListBase(fontBase);
+    vector<string> lines = stats.lines();
+    for (size_t i = 0; i < lines.size(); i++) {
+        glRasterPos2i(LINEHEIGHT / 2, h - (GLint)(i + 1) * LINEHEIGHT);
+        glCallLists(lines[i].size(), GL_UNSIGNED_BYTE, lines[i].c_str());
+    }
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
 }
 
 /**
@@ -173,7 +586,7 @@ bool SceneView::on_motion_notify_event(GdkEventMotion* event) {
                          (2.0f * cx - w) / w,
                          (h - 2.0f * cy) / h);
         add_quats(lastQ, currQ, currQ);
-        get_window()->invalidate_rect(get_allocation(), false);
+        move();
     }
     mx = cx;
     my = cy;
@@ -200,57 +613,123 @@ bool SceneView::on_scroll_event(GdkEventScroll* event) {
         default:
             break;
     }
-    get_window()->invalidate_rect(get_allocation(), false);
+    move();
     return true;
 }
 
 /**
  * Render the 3D point cloud
+ * The leaves of the octree in the view are rendered, and the head of
+ * the points in each leaf is rendered if the points exceed the budget.
+ * @return number of the points rendered
  */
-void SceneView::renderPointCloud() {
-    glPushMatrix();
+GLsizei SceneView::renderPointCloud() {
     glPointSize(1.0f);
-    glBegin(GL_POINTS);
-    for_each(vtcs.begin(), vtcs.end(), [](const Vertex& vtx) {
-        glColor3dv(vtx.color3d());
-        glVertex3dv(vtx.position3d());
+    if (!octree || !pointBuf) {
+        glDrawArrays(GL_POINTS, 0, nVtcs);
+        return nVtcs;
+    }
+    GLfloat mv[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+    vector<int> leaves;
+    cullNode(0, mv, false, leaves);
+    const vector<Octree::Node>& nodes = octree->nodes();
+    size_t nPts = 0;
+    for_each(leaves.begin(), leaves.end(), [&](int leaf) {
+        nPts += nodes[leaf].count;
     });
-    glEnd();
-    glPopMatrix();
+    double ratio = (moving && nPts > (size_t)pointBudget ? (double)pointBudget / (double)nPts : 1.0);
+    vector<GLsizei> counts;
+    vector<const GLvoid*> ofss;
+    counts.reserve(leaves.size());
+    ofss.reserve(leaves.size());
+    GLsizei nRendered = 0;
+    for_each(leaves.begin(), leaves.end(), [&](int leaf) {
+        counts.push_back((GLsizei)ceil(nodes[leaf].count * ratio));
+        ofss.push_back((const GLvoid*)(nodes[leaf].first * sizeof(GLuint)));
+        nRendered += counts.back();
+    });
+    if (counts.empty()) {
+        return 0;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pointBuf);
+    glMultiDrawElements(GL_POINTS, counts.data(), GL_UNSIGNED_INT, ofss.data(), counts.size());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return nRendered;
+}
+
+/**
+ * Collect the leaves of the octree in the view
+ * @param index of the node
+ * @param model view matrix
+ * @param the node is inside the view or not
+ * @param leaves in the view
+ */
+void SceneView::cullNode(int node, const GLfloat* mv, bool inside, vector<int>& leaves) const {
+    const Octree::Node& nd = octree->nodes()[node];
+    if (!inside) {
+        // transform the bounding box to the eye coordinates
+        double ctr[3], ext[3];
+        for (int i = 0; i < 3; i++) {
+            double c = mv[12+i], e = 0.0;
+            for (int j = 0; j < 3; j++) {
+                double bc = (nd.min[j] + nd.max[j]) / 2.0;
+                double be = (nd.max[j] - nd.min[j]) / 2.0;
+                c += mv[j*4+i] * bc;
+                e += fabs(mv[j*4+i]) * be;
+            }
+            ctr[i] = c;
+            ext[i] = e;
+        }
+        const double lo[] = { -viewW, -viewH, -FARCLIP };
+        const double hi[] = {  viewW,  viewH, -NEARCLIP };
+        inside = true;
+        for (int i = 0; i < 3; i++) {
+            if (ctr[i] - ext[i] > hi[i] || ctr[i] + ext[i] < lo[i]) {
+                return;
+            }
+            if (ctr[i] - ext[i] < lo[i] || ctr[i] + ext[i] > hi[i]) {
+                inside = false;
+            }
+        }
+    }
+    if (nd.isLeaf()) {
+        leaves.push_back(node);
+        return;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (nd.child[i] >= 0) {
+            cullNode(nd.child[i], mv, inside, leaves);
+        }
+    }
 }
 
 /**
  * Render the edges of the 3D polygon
+ * @return number of the edges rendered
  */
-void SceneView::renderEdges() {
-    glPushMatrix();
+GLsizei SceneView::renderEdges() {
+    if (nEdgeIdxs == 0) {
+        return 0;
+    }
     glLineWidth(1.0f);
-    for_each(faceVtxIdxs.begin(), faceVtxIdxs.end(), [&](const vector<uint>& vtxIdxs) {
-        glBegin(GL_LINE_LOOP);
-        for_each(vtxIdxs.begin(), vtxIdxs.end(), [&](uint vtxIdx) {
-            Vertex vtx = vtcs[vtxIdx];
-            glColor3dv(vtx.color3d());
-            glVertex3dv(vtx.position3d());
-        });
-        glEnd();
-    });
-    glPopMatrix();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeBuf);
+    glDrawElements(GL_LINES, nEdgeIdxs, GL_UNSIGNED_INT, (const GLvoid*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return nEdgeIdxs / 2;
 }
 
 /**
  * Render the surfaces of the 3D polygon
+ * @return number of the triangles rendered
  */
-void SceneView::renderSurface() {
-    glPushMatrix();
-    for_each(faceVtxIdxs.begin(), faceVtxIdxs.end(), [&](const vector<uint>& vtxIdxs) {
-        glBegin(GL_TRIANGLES);
-        for_each(vtxIdxs.begin(), vtxIdxs.end(), [&](uint vtxIdx) {
-            Vertex vtx = vtcs[vtxIdx];
-            glColor3dv(vtx.color3d());
-            glVertex3dv(vtx.position3d());
-        });
-        glEnd();
-    });
-    glPopMatrix();
+GLsizei SceneView::renderSurface() {
+    if (nFaceIdxs == 0) {
+        return 0;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceBuf);
+    glDrawElements(GL_TRIANGLES, nFaceIdxs, GL_UNSIGNED_INT, (const GLvoid*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return nFaceIdxs / 3;
 }
 
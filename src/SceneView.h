@@ -6,6 +6,15 @@
  *  - The 3D point cloud, the edges and surfaces of the 3D polygon are rendered.
  *  - The 3D polygon is rotated by the mouse drag.
  *  - The 3D polygon is zoomed in/out by the mouse wheel.
+ *  - The level of detail of the 3D polygon is selectable.
+ *  - The vertices and the indexes are uploaded to the buffer objects
+ *    when the model is updated, and rendered by the indexed draw calls.
+ *  - The scene is rendered only when it is changed,
+ *    at most once per frame interval, and cached in the frame buffer object.
+ *  - The point cloud is divided by the octree, the nodes out of the view are culled
+ *    and the points are subsampled under the budget while the polygon is moving.
+ *  - The render statistics are shown in the overlay and written to the log.
+ *  - The point cloud is rendered before the polygon mesh is constructed.
  * 
  * File:   SceneView.h
  * Author: munehiro
@@ -16,23 +25,43 @@
 #ifndef SCENEVIEW_H
 #define	SCENEVIEW_H
 
+#include <memory>
+#include <ostream>
 #include <vector>
 #include <gtkglextmm-1.2/gtkglmm.h>
 #include "Observer.h"
-
-typedef unsigned int uint;
+#include "RenderStats.h"
 
 using namespace std;
 
-class Vertex;
+class Octree;
 
 class SceneView : public Gtk::GL::DrawingArea, public Observer {
 public:
     SceneView();
     virtual ~SceneView();
-    virtual void update(const Subject* subject);
+    // the layer of the scene
+    enum struct Layer : int {
+        PointCloud, // 3D point cloud
+        Edges,      // edges of the 3D polygon
+        Surface     // surfaces of the 3D polygon
+    };
+    virtual void update(const Subject* subject, unsigned int changes);
+    // verify whether the layer is rendered
+    bool isLayerVisible(Layer layer) const { return visible[(int)layer]; };
+    void setLayerVisible(Layer layer, bool visible);
+    void setPointBudget(GLsizei budget);
+    // get the number of the levels of detail
+    size_t nLevelsOfDetail() const { return lodIdxs.size(); };
+    // get the level of detail
+    size_t levelOfDetail() const { return lod; };
+    void setLevelOfDetail(size_t lod);
+    // verify whether the render statistics are shown
+    bool isStatsEnabled() const { return stats.isEnabled(); };
+    void setStatsEnabled(bool enabled, ostream* log = nullptr);
 protected:
     virtual void on_realize();
+    virtual void on_unrealize();
     virtual bool on_configure_event(GdkEventConfigure* event);
     virtual bool on_expose_event(GdkEventExpose* event);
     virtual bool on_button_press_event(GdkEventButton* event);
@@ -41,14 +70,58 @@ protected:
 private:
     // the eye point, the near and the far clip of the scene view
     static const GLdouble EYEPOINT, NEARCLIP, FARCLIP;
-    void renderPointCloud();
-    void renderEdges();
-    void renderSurface();
+    // interval of rendering the changed scene in milliseconds
+    static const unsigned int FRAMEINTERVAL;
+    // delay to refine the point cloud after the polygon stops in milliseconds
+    static const unsigned int REFINEDELAY;
+    // default maximum number of the points rendered while the polygon is moving
+    static const GLsizei POINTBUDGET;
+    // font and height of the lines of the render statistics overlay
+    static const char* OVERLAYFONT;
+    static const GLint LINEHEIGHT;
+    void invalidate();
+    bool onFrame();
+    void move();
+    bool onRefine();
+    void cullNode(int node, const GLfloat* mv, bool inside, vector<int>& leaves) const;
+    void resizeFrameBuffer(GLsizei w, GLsizei h);
+    void renderScene();
+    void renderLayer(Layer layer, GLsizei (SceneView::*render)());
+    void renderOverlay();
+    void upload();
+    GLsizei renderPointCloud();
+    GLsizei renderEdges();
+    GLsizei renderSurface();
     // x and y position of the mouse, the quaternion for the polygon rotation
     float mx, my, currQ[4];
     double scl;             // scale of the polygon
-    vector<Vertex> vtcs;                // vertices of the polygon
-    vector<vector<uint>> faceVtxIdxs;   // vertex indexes of the polygon surfaces
+    // positions and colors of the vertices to be uploaded
+    vector<GLfloat> positions;
+    vector<GLubyte> colors;
+    shared_ptr<const vector<uint32_t>> faceIdxs;    // vertex indexes of the polygon surfaces
+    // vertex indexes of the polygon surfaces at each level of detail
+    vector<shared_ptr<const vector<uint32_t>>> lodIdxs;
+    size_t lod;             // level of detail
+    // the vertices or the indexes are not uploaded yet
+    bool vtxDirty, idxDirty;
+    // buffer objects of the vertices, the surface and the unique edge indexes
+    GLuint vtxBuf, faceBuf, edgeBuf;
+    // number of the vertices, the surface and the edge indexes in the buffer objects
+    GLsizei nVtcs, nFaceIdxs, nEdgeIdxs;
+    shared_ptr<Octree> octree;  // octree of the point cloud
+    GLuint pointBuf;            // buffer object of the point indexes in the order of the octree
+    GLsizei pointBudget;        // maximum number of the points rendered while moving
+    bool moving;                // the polygon is moving or not
+    sigc::connection refineConn;    // pending timeout to refine the point cloud
+    GLdouble viewW, viewH;      // half width and height of the orthogonal view
+    bool visible[3];        // the layers are rendered or not
+    bool sceneDirty;        // the scene is changed after it is cached
+    sigc::connection frameConn;     // pending frame to render the changed scene
+    // frame buffer object to cache the scene, the color and the depth render buffers
+    GLuint frameBuf, colorBuf, depthBuf;
+    bool frameBufSupported; // the frame buffer object is supported by the context or not
+    RenderStats stats;      // render statistics
+    GLuint fontBase;        // display lists of the overlay font
 
 };
 
@@ -2,6 +2,13 @@
  * StereoCamera Class
  *  - The stereo camera is implemented.
  *  - The stereo camera is calibrated by using OpenCV Library.
+ *  - The calibration rig patterns of all the images of the both cameras
+ *    are detected in parallel.
+ *  - The calibration is started from the previous intrinsic parameters,
+ *    if they are for the same size of the images.
+ *  - The camera parameters are read and written in binary.
+ *  - The rectification maps are computed when they are used first,
+ *    and shared by the copies of the stereo camera.
  *  - The 3D point cloud is constructed from the stereo image
  *    by using OpenCV Library.
  * 
@@ -12,9 +19,14 @@
  */
 
 #include <cfloat>
+#include <chrono>
+#include <sstream>
 #include "StereoCamera.h"
 #include "Image.h"
 #include "Vertex.h"
+#include "Parallel.h"
+#include "FrameContext.h"
+#include "Trace.h"
 
 const uint StereoCamera::MINOFNIMAGES = 3;
 const string StereoCamera::PARAMFILENAME("param.yml");
@@ -22,12 +34,17 @@ const string StereoCamera::PARAMFILENAME("param.yml");
 /**
  * Constructors and Destructor
  */
-StereoCamera::StereoCamera() : maxZ(1000.0) {
+StereoCamera::StereoCamera() : maxZ(1000.0), subPixCrit(Image::SUBPIXCRITERIA), rect(new Rectification) {
 }
 
-StereoCamera::StereoCamera(const StereoCamera& orig) : maxZ(orig.maxZ) {
-    copy(orig.camMat, orig.camMat+2, camMat);
-    copy(orig.dstCof, orig.dstCof+2, dstCof);
+StereoCamera::StereoCamera(const StereoCamera& orig)
+: maxZ(orig.maxZ), subPixCrit(orig.subPixCrit), rect(orig.rect) {
+    // the detections of the last calibration are not copied
+    // the intrinsic parameters are deep copied, because they are updated in place by the calibration
+    for (int i = 0; i < 2; i++) {
+        camMat[i] = orig.camMat[i].clone();
+        dstCof[i] = orig.dstCof[i].clone();
+    }
     rotMat = orig.rotMat.clone();
     trnVec = orig.trnVec.clone();
     essMat = orig.essMat.clone();
@@ -39,12 +56,13 @@ StereoCamera::~StereoCamera() {
 }
 
 /**
- * Open the camera parameters
+ * Open the camera parameters in YAML
+ * @param file name
  * @return read or not
  */
-bool StereoCamera::open() {
+bool StereoCamera::open(const string& fn) {
     cv::FileStorage fs;
-    if (fs.open(PARAMFILENAME, cv::FileStorage::READ)) {
+    if (fs.open(fn, cv::FileStorage::READ)) {
         fs["C1"] >> camMat[0];
         fs["D1"] >> dstCof[0];
         fs["C2"] >> camMat[1];
@@ -54,14 +72,67 @@ bool StereoCamera::open() {
         fs["E"] >> essMat;
         fs["F"] >> funMat;
         fs.release();
+        rect.reset(new Rectification);
         return true;
     } else {
         return false;
     }
 }
 
+/**
+ * Read the camera parameters in binary
+ * @param input stream
+ */
+void StereoCamera::read(istream& is) {
+    cv::Mat* mats[] = { &camMat[0], &dstCof[0], &camMat[1], &dstCof[1], &rotMat, &trnVec, &essMat, &funMat };
+    for_each(mats, mats + 8, [&](cv::Mat* mat) { readMat(is, *mat); });
+    is.read((char*)&maxZ, sizeof(maxZ));
+    if (!is) {
+        throw string("Invalid camera parameters");
+    }
+    rect.reset(new Rectification);
+}
+
+/**
+ * Write the camera parameters in binary
+ * @param output stream
+ */
+void StereoCamera::write(ostream& os) const {
+    const cv::Mat* mats[] = { &camMat[0], &dstCof[0], &camMat[1], &dstCof[1], &rotMat, &trnVec, &essMat, &funMat };
+    for_each(mats, mats + 8, [&](const cv::Mat* mat) { writeMat(os, *mat); });
+    os.write((const char*)&maxZ, sizeof(maxZ));
+}
+
+/**
+ * Read the matrix in binary
+ * @param input stream
+ * @param matrix
+ */
+void StereoCamera::readMat(istream& is, cv::Mat& mat) {
+    int32_t hdr[3];     // rows, columns and type
+    if (!is.read((char*)hdr, sizeof(hdr)) || hdr[0] < 0 || hdr[1] < 0 || hdr[0] * hdr[1] > 256 ||
+            CV_MAT_TYPE(hdr[2]) != hdr[2]) {
+        throw string("Invalid camera parameters");
+    }
+    mat.create(hdr[0], hdr[1], hdr[2]);
+    is.read((char*)mat.data, mat.total() * mat.elemSize());
+}
+
+/**
+ * Write the matrix in binary
+ * @param output stream
+ * @param matrix
+ */
+void StereoCamera::writeMat(ostream& os, const cv::Mat& mat) {
+    cv::Mat cont = (mat.isContinuous() ? mat : mat.clone());
+    int32_t hdr[] = { cont.rows, cont.cols, cont.type() };
+    os.write((const char*)hdr, sizeof(hdr));
+    os.write((const char*)cont.data, cont.total() * cont.elemSize());
+}
+
 /**
  * Calibrate the stereo camera
+ * The error of the detection is reported with the numbers of all the failed images.
  * @param stereo images
  * @param type of calibration rig pattern
  * @param number of rows on the calibration rig pattern
@@ -73,46 +144,129 @@ void StereoCamera::calibrate(vector<Image>* imgs, RigDialog::Pattern ptn, int ro
     if (imgs[0].size() != imgs[1].size() || imgs[0].size() < MINOFNIMAGES) {
         throw string("Number of image must be 3 or more");
     }
-    // pre-calibration
-    vector<vector<cv::Point3f>> objPts = calcObjectPoints(imgs[0].size(), rows, cols, dist);
+    // find corners or centers of the images that taken the calibration rig
+    detectPatterns(imgs, ptn, rows, cols);
     vector<vector<cv::Point2f>> imgPts[2];
-    cv::Size imgSize(imgs[0][0].size());
-    vector<cv::Mat> rvecs[2], tvecs[2];
-    // calibrate the left and the right cameras
     for (int i = 0; i < 2; i++) {
-        // find corners or centers of the image that taken the calibration rig
-        for_each(imgs[i].begin(), imgs[i].end(), [&](Image& img) {
-            vector<cv::Point2f> centers;
-            if (ptn == RigDialog::Pattern::Chessboard) {
-                centers = img.findChessboardCorners(rows, cols);
-            } else if (ptn == RigDialog::Pattern::CircleGrid) {
-                centers = img.findCircleGrid(rows, cols);
-            } else {
-                throw string("Invalid calibration pattern");
-            }
-            imgPts[i].push_back(centers);
+        for_each(dtcts[i].begin(), dtcts[i].end(), [&](const Detection& dtct) {
+            imgPts[i].push_back(dtct.centers);
         });
-        // calibrate the left or the right cameras
-        cv::calibrateCamera(objPts, imgPts[i], imgSize,
-                camMat[i], dstCof[i], rvecs[i], tvecs[i], 0,
-                cv::TermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 1000, 1.0e-8));
     }
+    calibrate(imgPts, imgs[0][0].size(), rows, cols, dist);
+}
+
+/**
+ * Calibrate the stereo camera by the detected corners or centers
+ * The previous intrinsic parameters are used as the initial guess.
+ * @param corners or centers in the left and the right images
+ * @param size of the images
+ * @param number of rows on the calibration rig pattern
+ * @param number of columns on the calibration rig pattern
+ * @param distance between corners or centers on the calibration rig pattern
+ */
+void StereoCamera::calibrate(const vector<vector<cv::Point2f>>* imgPts, cv::Size imgSize,
+        int rows, int cols, double dist) {
+    funMat.release();
+    if (imgPts[0].size() != imgPts[1].size() || imgPts[0].size() < MINOFNIMAGES) {
+        throw string("Number of image must be 3 or more");
+    }
+    // pre-calibration
+    vector<vector<cv::Point3f>> objPts = calcObjectPoints(imgPts[0].size(), rows, cols, dist);
+    vector<cv::Mat> rvecs[2], tvecs[2];
+    // calibrate the left and the right cameras at the same time
+    Parallel::range(2, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            TRACE_SCOPE("calibrateCamera");
+            int flags = (isIntrinsicGuess(i, imgSize) ? CV_CALIB_USE_INTRINSIC_GUESS : 0);
+            cv::calibrateCamera(objPts, imgPts[i], imgSize,
+                    camMat[i], dstCof[i], rvecs[i], tvecs[i], flags,
+                    cv::TermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 1000, 1.0e-8));
+        }
+    }, 1);
     // calibrate the stereo camera
+    TRACE_SCOPE("stereoCalibrate");
     cv::stereoCalibrate(objPts, imgPts[0], imgPts[1], camMat[0], dstCof[0],
             camMat[1], dstCof[1], imgSize, rotMat, trnVec, essMat, funMat,
             cv::TermCriteria(CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 1000, 1.0e-8),
             CV_CALIB_FIX_INTRINSIC);
-    // save the camera parameters
-    cv::FileStorage fs(PARAMFILENAME, cv::FileStorage::WRITE);
-    fs << "C1" << camMat[0];
-    fs << "D1" << dstCof[0];
-    fs << "C2" << camMat[1];
-    fs << "D2" << dstCof[1];
-    fs << "R" << rotMat;
-    fs << "T" << trnVec;
-    fs << "E" << essMat;
-    fs << "F" << funMat;
-    fs.release();
+    // the copies of the stereo camera keep the previous rectification maps
+    rect.reset(new Rectification);
+}
+
+/**
+ * Verify whether the intrinsic parameters are used as the initial guess
+ * The parameters must be valid and their principal point must be near the center of the images.
+ * @param left or right camera
+ * @param size of the images
+ * @return used or not
+ */
+bool StereoCamera::isIntrinsicGuess(int cam, cv::Size imgSize) const {
+    if (camMat[cam].rows != 3 || camMat[cam].cols != 3 || camMat[cam].type() != CV_64F) {
+        return false;
+    }
+    double cx = camMat[cam].at<double>(0, 2);
+    double cy = camMat[cam].at<double>(1, 2);
+    return (fabs(cx - imgSize.width / 2.0) < imgSize.width / 4.0 &&
+            fabs(cy - imgSize.height / 2.0) < imgSize.height / 4.0);
+}
+
+/**
+ * Detect the calibration rig pattern in the images of the both cameras
+ * The images are processed in parallel, and the detections are kept in the order of the images.
+ * The error is reported with the numbers of all the failed images.
+ * @param stereo images
+ * @param type of calibration rig pattern
+ * @param number of rows on the calibration rig pattern
+ * @param number of columns on the calibration rig pattern
+ */
+void StereoCamera::detectPatterns(vector<Image>* imgs, RigDialog::Pattern ptn, int rows, int cols) {
+    if (ptn != RigDialog::Pattern::Chessboard && ptn != RigDialog::Pattern::CircleGrid) {
+        throw string("Invalid calibration pattern");
+    }
+    if (imgs[0].size() != imgs[1].size()) {
+        throw string("Number of image must be the same");
+    }
+    const size_t nImgs = imgs[0].size();
+    for (int i = 0; i < 2; i++) {
+        dtcts[i].assign(nImgs, Detection());
+    }
+    Parallel::range(nImgs * 2, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Detection& dtct = dtcts[i / nImgs][i % nImgs];
+            Image& img = imgs[i / nImgs][i % nImgs];
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            TRACE_SCOPE("detect");
+            try {
+                if (ptn == RigDialog::Pattern::Chessboard) {
+                    dtct.centers = img.findChessboardCorners(rows, cols, subPixCrit);
+                } else {
+                    dtct.centers = img.findCircleGrid(rows, cols);
+                }
+            } catch (const string& msg) {
+                dtct.error = msg;
+            }
+            dtct.msec = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        }
+    }, 1);
+    // report all the failed images at once
+    string err;
+    ostringstream imgNos;
+    for (int i = 0; i < 2; i++) {
+        for (size_t j = 0; j < nImgs; j++) {
+            if (dtcts[i][j].error.empty()) {
+                continue;
+            }
+            if (err.empty()) {
+                err = dtcts[i][j].error;
+            } else {
+                imgNos << ",";
+            }
+            imgNos << " " << (i == 0 ? "left" : "right") << " image " << j + 1;
+        }
+    }
+    if (!err.empty()) {
+        throw err + " in" + imgNos.str();
+    }
 }
 
 /**
@@ -151,8 +305,35 @@ vector<Vertex> StereoCamera::reprojectImageTo3D(vector<Image>& imgs) {
     // compute the disparity map
 //    imgs.push_back(disp.computeDisparityMapBM(imgs, validRoi));
     imgs.push_back(disp.computeDisparityMapSGBM(imgs));
+    return reprojectDisparityTo3D(disp, imgs[0], qMat);
+}
+
+/**
+ * Construct the 3D point cloud from the disparity map
+ * @param disparity map
+ * @param rectified left image for the colors
+ * @param Q matrix of the rectification
+ * @return 3D point cloud
+ */
+vector<Vertex> StereoCamera::reprojectDisparityTo3D(const Image& disp, const Image& img, const cv::Mat& qMat) {
+    vector<Vertex> vtcs;
+    reprojectDisparityTo3D(disp, img, qMat, vtcs);
+    return vtcs;
+}
+
+/**
+ * Construct the 3D point cloud from the disparity map into the vertices
+ * @param disparity map
+ * @param rectified left image for the colors
+ * @param Q matrix of the rectification
+ * @param vertices, which are cleared and keep their capacity
+ * @param frame context for the buffers, or null
+ */
+void StereoCamera::reprojectDisparityTo3D(const Image& disp, const Image& img, const cv::Mat& qMat,
+        vector<Vertex>& vtcs, FrameContext* ctx) {
     // construct the 3D point cloud from the disparity map
-    cv::Mat _3dImg;
+    cv::Mat tmp;
+    cv::Mat& _3dImg = (ctx ? ctx->mat("reproject.3d") : tmp);
     cv::reprojectImageTo3D(disp.image(), _3dImg, qMat);
     // relieve the invalid data that
     // infinite, negative and out of range data
@@ -166,7 +347,7 @@ vector<Vertex> StereoCamera::reprojectImageTo3D(vector<Image>& imgs) {
             minZ = (minZ > pt.z ? pt.z : minZ);
         }
     }
-    vector<Vertex> vtcs;
+    vtcs.clear();
     for (int i = 0; i < _3dImg.rows; i++) {
         for (int j = 0; j < _3dImg.cols; j++) {
             cv::Point3f pt = _3dImg.at<cv::Point3f>(i, j);
@@ -175,7 +356,7 @@ vector<Vertex> StereoCamera::reprojectImageTo3D(vector<Image>& imgs) {
             }
             Vertex vtx;
             vtx.setPosition(pt.x, -pt.y, maxZ-pt.z);
-            cv::Vec3b c = imgs[0].image().at<cv::Vec3b>(i, j);
+            cv::Vec3b c = img.image().at<cv::Vec3b>(i, j);
             vtx.setColor(c(2), c(1), c(0));
             vtcs.push_back(vtx);
         }
@@ -183,27 +364,47 @@ vector<Vertex> StereoCamera::reprojectImageTo3D(vector<Image>& imgs) {
     if (vtcs.size() == 0) {
         throw string("Point cloud is empty");
     }
-    return vtcs;
 }
 
 /**
  * Transform rectification
+ * The maps are computed for the first images of the size, and reused for the next images.
  * @param stereo image
+ * @param frame context for the buffers of the rectified images, or null
  * @return Q matrix
  */
-cv::Mat StereoCamera::transformRectification(vector<Image>& imgs) {
+cv::Mat StereoCamera::transformRectification(vector<Image>& imgs, FrameContext* ctx) {
     cv::Size imgSize(imgs[0].size());
-    cv::Mat recMat[2], prjMat[2], qMat;
-    // compute stereo rectification transformation
-    cv::stereoRectify(camMat[0], dstCof[0], camMat[1], dstCof[1], imgSize,
-            rotMat, trnVec, recMat[0], recMat[1], prjMat[0], prjMat[1], qMat,
-            cv::CALIB_ZERO_DISPARITY, -1.0, imgSize, &validRoi[0], &validRoi[1]);
+    cv::Mat rmap[2][2], qMat;
+    {
+        // compute the maps only for the first images of the size
+        lock_guard<mutex> lock(rect->mtx);
+        if (rect->imgSize != imgSize) {
+            cv::Mat recMat[2], prjMat[2];
+            // compute stereo rectification transformation
+            cv::stereoRectify(camMat[0], dstCof[0], camMat[1], dstCof[1], imgSize,
+                    rotMat, trnVec, recMat[0], recMat[1], prjMat[0], prjMat[1], rect->qMat,
+                    cv::CALIB_ZERO_DISPARITY, -1.0, imgSize, &rect->validRoi[0], &rect->validRoi[1]);
+            for (int i = 0; i < 2; i++) {
+                cv::initUndistortRectifyMap(camMat[i], dstCof[i], recMat[i], prjMat[i],
+                        imgSize, CV_16SC2, rect->rmap[i][0], rect->rmap[i][1]);
+            }
+            rect->imgSize = imgSize;
+        }
+        for (int i = 0; i < 2; i++) {
+            rmap[i][0] = rect->rmap[i][0];
+            rmap[i][1] = rect->rmap[i][1];
+            validRoi[i] = rect->validRoi[i];
+        }
+        qMat = rect->qMat.clone();
+    }
     // transform rectification
     for (int i = 0; i < 2; i++) {
-        cv::Mat rmap[2];
-        cv::initUndistortRectifyMap(camMat[i], dstCof[i], recMat[i], prjMat[i],
-                imgSize, CV_16SC2, rmap[0], rmap[1]);
-        imgs[i].remap(rmap);
+        if (ctx) {
+            imgs[i].remap(rmap[i], ctx->mat("rectify" + to_string(i)));
+        } else {
+            imgs[i].remap(rmap[i]);
+        }
     }
     return qMat;
 }
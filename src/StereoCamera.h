@@ -2,6 +2,13 @@
  * StereoCamera Class
  *  - The stereo camera is implemented.
  *  - The stereo camera is calibrated by using OpenCV Library.
+ *  - The calibration rig patterns of all the images of the both cameras
+ *    are detected in parallel.
+ *  - The calibration is started from the previous intrinsic parameters,
+ *    if they are for the same size of the images.
+ *  - The camera parameters are read and written in binary.
+ *  - The rectification maps are computed when they are used first,
+ *    and shared by the copies of the stereo camera.
  *  - The 3D point cloud is constructed from the stereo image
  *    by using OpenCV Library.
  * 
@@ -14,7 +21,10 @@
 #ifndef STEREOCAMERA_H
 #define	STEREOCAMERA_H
 
+#include <istream>
 #include <memory>
+#include <mutex>
+#include <ostream>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "RigDialog.h"
@@ -23,24 +33,63 @@ using namespace std;
 
 class Image;
 class Vertex;
+class FrameContext;
 
 class StereoCamera {
 public:
+    // result of the detection of the calibration rig pattern in the image
+    struct Detection {
+        vector<cv::Point2f> centers;    // corners or centers, empty if not found
+        double msec;                    // time to detect in milliseconds
+        string error;                   // error message, empty if found
+    };
     // minimum the number of images required for calibration
     static const uint MINOFNIMAGES;
+    // file name for camera parameters in YAML
+    static const string PARAMFILENAME;
     StereoCamera();
     StereoCamera(const StereoCamera& orig);
     virtual ~StereoCamera();
     // verify whether the stereo camera is calibrated
     bool isValid() const { return !funMat.empty(); };
-    bool open();
+    bool open(const string& fn = PARAMFILENAME);
+    void read(istream& is);
+    void write(ostream& os) const;
     void calibrate(vector<Image>* imgs, RigDialog::Pattern ptn, int rows, int cols, double dist);
+    void calibrate(const vector<vector<cv::Point2f>>* imgPts, cv::Size imgSize, int rows, int cols, double dist);
+    void detectPatterns(vector<Image>* imgs, RigDialog::Pattern ptn, int rows, int cols);
+    // set the criteria to refine the chessboard corners to the sub-pixel accuracy
+    void setSubPixCriteria(const cv::TermCriteria& crit) { subPixCrit = crit; };
+    // get the detections of the last calibration of the left or the right camera
+    const vector<Detection>& detections(int cam) const { return dtcts[cam]; };
+    // get the intrinsic parameters of the left or the right camera
+    const cv::Mat& cameraMatrix(int cam) const { return camMat[cam]; };
+    // get the distortion coefficients of the left or the right camera
+    const cv::Mat& distortionCoefficients(int cam) const { return dstCof[cam]; };
+    // get the rotation matrix from the left to the right camera
+    const cv::Mat& rotation() const { return rotMat; };
+    // get the translation vector from the left to the right camera
+    const cv::Mat& translation() const { return trnVec; };
+    // get the maximum range of the z axis, from which the z of the point cloud is measured
+    double maxRange() const { return maxZ; };
     vector<Vertex> reprojectImageTo3D(vector<Image>& imgs);
+    cv::Mat transformRectification(vector<Image>& imgs, FrameContext* ctx = nullptr);
+    vector<Vertex> reprojectDisparityTo3D(const Image& disp, const Image& img, const cv::Mat& qMat);
+    void reprojectDisparityTo3D(const Image& disp, const Image& img, const cv::Mat& qMat,
+                                vector<Vertex>& vtcs, FrameContext* ctx = nullptr);
 private:
-    // file name for camera parameters
-    static const string PARAMFILENAME;
+    // the rectification maps for the size of the images
+    struct Rectification {
+        mutex mtx;              // mutex of the maps
+        cv::Size imgSize;       // size of the images, or empty if the maps are not computed
+        cv::Mat rmap[2][2];     // maps of the left and the right images
+        cv::Mat qMat;           // Q matrix
+        cv::Rect validRoi[2];   // ROI of the rectified image
+    };
+    static void readMat(istream& is, cv::Mat& mat);
+    static void writeMat(ostream& os, const cv::Mat& mat);
     vector<vector<cv::Point3f>> calcObjectPoints(int nImgs, int rows, int cols, double dist);
-    cv::Mat transformRectification(vector<Image>& imgs);
+    bool isIntrinsicGuess(int cam, cv::Size imgSize) const;
     // camera intrinsic parameters and distortion coefficients
     cv::Mat camMat[2], dstCof[2];
     // rotation matrix and translation vector between the left and the right cameras,
@@ -48,6 +97,9 @@ private:
     cv::Mat rotMat, trnVec, essMat, funMat;
     cv::Rect validRoi[2];   // ROI of the rectified image
     double maxZ;            // maximum range of the z axis 
+    cv::TermCriteria subPixCrit;    // criteria of the sub-pixel refinement
+    shared_ptr<Rectification> rect; // rectification maps shared by the copies
+    vector<Detection> dtcts[2];     // detections of the last calibration
 
 };
 
@@ -1,6 +1,9 @@
 /* 
  * Subject class
  *  - The subject of Observer pattern.
+ *  - The observers are notified of the mask of the changes.
+ *  - The notifications between beginUpdate and endUpdate are coalesced,
+ *    and the observers are notified once of all the changes at the end.
  * 
  * File:   Subject.cpp
  * Author: munehiro
@@ -11,11 +14,14 @@
 #include <algorithm>
 #include "Subject.h"
 #include "Observer.h"
+#include "Trace.h"
+
+const unsigned int Subject::ALLCHANGES = ~0u;
 
 /**
  * Constructor and Destructor
  */
-Subject::Subject() {
+Subject::Subject() : nUpdates(0), pending(0) {
 }
 
 Subject::~Subject() {
@@ -44,10 +50,41 @@ void Subject::detach(const shared_ptr<Observer> observer) {
 
 /**
  * Update observers
+ * The observers are not notified if nothing is changed,
+ * and the changes are held until the update is ended.
+ * @param mask of the changes
  */
-void Subject::notify() {
-    for_each(observers.begin(), observers.end(), [this](shared_ptr<Observer> observer) {
-        observer->update(this);
+void Subject::notify(unsigned int changes) {
+    pending |= changes;
+    if (nUpdates > 0 || pending == 0) {
+        return;
+    }
+    TRACE_SCOPE("notify");
+    changes = pending;
+    pending = 0;
+    // the observer may be detached while it is updated
+    vector<shared_ptr<Observer>> obs(observers);
+    for_each(obs.begin(), obs.end(), [&](shared_ptr<Observer> observer) {
+        observer->update(this, changes);
     });
 }
 
+/**
+ * Begin the update
+ * The notifications are coalesced until the update is ended.
+ * The updates can be nested.
+ */
+void Subject::beginUpdate() {
+    nUpdates++;
+}
+
+/**
+ * End the update
+ * The observers are notified of all the changes in the outermost update.
+ */
+void Subject::endUpdate() {
+    if (nUpdates > 0 && --nUpdates == 0) {
+        notify(0);
+    }
+}
+
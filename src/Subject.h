@@ -1,6 +1,9 @@
 /* 
  * Subject class
  *  - The subject of Observer pattern.
+ *  - The observers are notified of the mask of the changes.
+ *  - The notifications between beginUpdate and endUpdate are coalesced,
+ *    and the observers are notified once of all the changes at the end.
  * 
  * File:   Subject.h
  * Author: munehiro
@@ -20,13 +23,19 @@ class Observer;
 
 class Subject {
 public:
+    // mask of all the changes
+    static const unsigned int ALLCHANGES;
     Subject();
     virtual ~Subject();
     void attach(const shared_ptr<Observer> observer);
     void detach(const shared_ptr<Observer> observer);
-    void notify();
+    void notify(unsigned int changes = ALLCHANGES);
+    void beginUpdate();
+    void endUpdate();
 private:
     vector<shared_ptr<Observer>> observers;     // observer list
+    int nUpdates;           // depth of the nested updates
+    unsigned int pending;   // mask of the changes that are not notified yet
 
 };
 
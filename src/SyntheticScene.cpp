@@ -0,0 +1,272 @@
+/* 
+ * SyntheticScene Class
+ *  - The known textured 3D scene is rendered through the stereo camera
+ *    to test the construction at any resolution.
+ *  - The scene is the slanted plane with the sphere in front of it,
+ *    and its depths are in the search range of the disparity map.
+ *  - The cameras are the calibrated stereo camera scaled to the resolution,
+ *    or the rectified cameras with the synthetic intrinsic parameters.
+ *  - The depth of the left image is rendered as the ground truth.
+ * 
+ * File:   SyntheticScene.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:40 PM
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include "SyntheticScene.h"
+#include "Image.h"
+#include "StereoCamera.h"
+#include "Parallel.h"
+
+const double SyntheticScene::FARDISPARITY  = 0.40;
+const double SyntheticScene::NEARDISPARITY = 0.75;
+
+/**
+ * Constructor and Destructor
+ * The cameras are rectified with the synthetic intrinsic parameters,
+ * and the plane is at 800 millimeters.
+ * @param size of the images
+ * @param seed of the position of the sphere and the texture
+ */
+SyntheticScene::SyntheticScene(const cv::Size& size, unsigned int seed) : size(size) {
+    if (size.width <= 0 || size.height <= 0) {
+        throw string("Invalid image size");
+    }
+    const double f = 1.1 * size.width;
+    const int nDisp = ((size.width / 8) + 15) & -16;
+    const double baseline = 800.0 * FARDISPARITY * nDisp / f;
+    for (int i = 0; i < 2; i++) {
+        cams[i].camMat = (cv::Mat_<double>(3, 3) <<
+                f, 0.0, size.width / 2.0,
+                0.0, f, size.height / 2.0,
+                0.0, 0.0, 1.0);
+        cams[i].dstCof = cv::Mat::zeros(1, 5, CV_64F);
+        cams[i].rotMat = cv::Matx33d::eye();
+        cams[i].trnVec = cv::Vec3d((i == 0 ? 0.0 : -baseline), 0.0, 0.0);
+    }
+    setScene(seed);
+}
+
+/**
+ * Constructor
+ * The intrinsic parameters of the calibrated cameras are scaled to the size of the images.
+ * @param size of the images
+ * @param calibrated stereo camera
+ * @param size of the images that the stereo camera is calibrated with
+ * @param seed of the position of the sphere and the texture
+ */
+SyntheticScene::SyntheticScene(const cv::Size& size, const StereoCamera& sCam, const cv::Size& calibSize,
+        unsigned int seed) : size(size) {
+    if (size.width <= 0 || size.height <= 0 || calibSize.width <= 0 || calibSize.height <= 0) {
+        throw string("Invalid image size");
+    }
+    if (!sCam.isValid()) {
+        throw string("Stereo camera is not calibrated");
+    }
+    for (int i = 0; i < 2; i++) {
+        sCam.cameraMatrix(i).convertTo(cams[i].camMat, CV_64F);
+        cams[i].camMat.row(0) *= (double)size.width / calibSize.width;
+        cams[i].camMat.row(1) *= (double)size.height / calibSize.height;
+        sCam.distortionCoefficients(i).convertTo(cams[i].dstCof, CV_64F);
+    }
+    cv::Mat rot, trn;
+    sCam.rotation().convertTo(rot, CV_64F);
+    sCam.translation().convertTo(trn, CV_64F);
+    cams[0].rotMat = cv::Matx33d::eye();
+    cams[0].trnVec = cv::Vec3d(0.0, 0.0, 0.0);
+    cams[1].rotMat = cv::Matx33d((const double*)rot.data);
+    cams[1].trnVec = cv::Vec3d(trn.at<double>(0), trn.at<double>(1), trn.at<double>(2));
+    setScene(seed);
+}
+
+SyntheticScene::~SyntheticScene() {
+}
+
+/**
+ * Set the plane and the sphere by the disparities of the cameras
+ * @param seed of the position of the sphere and the texture
+ */
+void SyntheticScene::setScene(unsigned int seed) {
+    this->seed = seed;
+    const double f = cams[0].camMat.at<double>(0, 0);
+    const double baseline = cv::norm(cams[1].trnVec);
+    const int nDisp = ((size.width / 8) + 15) & -16;
+    const double zFar  = f * baseline / (FARDISPARITY * nDisp);
+    const double zNear = f * baseline / (NEARDISPARITY * nDisp);
+    // the plane is slanted to the right and the bottom
+    plnNormal = cv::normalize(cv::Vec3d(0.15, -0.1, -1.0));
+    plnDist = plnNormal.dot(cv::Vec3d(0.0, 0.0, zFar));
+    // the sphere is moved around the center by the seed
+    cv::RNG rng(seed);
+    sphRad = 0.45 * (zFar - zNear);
+    sphCtr = cv::Vec3d(rng.uniform(-0.1, 0.1) * zFar, rng.uniform(-0.1, 0.1) * zFar, zNear + sphRad);
+    // the cell of the texture is about 3 pixels on the plane
+    cell = 3.0 * zFar / f;
+}
+
+/**
+ * Render the left and the right images
+ * @param depth of the left image in millimeters as CV_32F,
+ *        which is 0 where the ray does not hit the scene, or null
+ * @return left and right images
+ */
+vector<Image> SyntheticScene::render(cv::Mat* depth) const {
+    if (depth) {
+        depth->create(size, CV_32F);
+    }
+    vector<Image> imgs;
+    for (int c = 0; c < 2; c++) {
+        const Camera& cam = cams[c];
+        cv::Mat img(size, CV_8UC3);
+        // the rays from the center of the camera in the coordinates of the left camera
+        const cv::Matx33d rotInv = cam.rotMat.t();
+        const cv::Vec3d org = -(rotInv * cam.trnVec);
+        Parallel::range(size.height, [&](size_t begin, size_t end) {
+            cv::Mat pxs(1, size.width, CV_64FC2), rays;
+            for (size_t y = begin; y < end; y++) {
+                for (int x = 0; x < size.width; x++) {
+                    pxs.at<cv::Vec2d>(0, x) = cv::Vec2d(x, (double)y);
+                }
+                // the normalized coordinates without the distortion
+                cv::undistortPoints(pxs, rays, cam.camMat, cam.dstCof);
+                cv::Vec3b* row = img.ptr<cv::Vec3b>(y);
+                float* dRow = (c == 0 && depth ? depth->ptr<float>(y) : nullptr);
+                for (int x = 0; x < size.width; x++) {
+                    const cv::Vec2d& ray = rays.at<cv::Vec2d>(0, x);
+                    cv::Vec3d pt;
+                    bool hit = intersect(org, rotInv * cv::Vec3d(ray[0], ray[1], 1.0), pt);
+                    row[x] = (hit ? texture(pt) : cv::Vec3b(0, 0, 0));
+                    if (dRow) {
+                        dRow[x] = (hit ? (float)pt[2] : 0.0f);
+                    }
+                }
+            }
+        }, 16);
+        imgs.push_back(Image(img));
+    }
+    return imgs;
+}
+
+/**
+ * Get the disparity-to-depth mapping matrix
+ * The matrix is valid for the synthetic cameras, which are rectified.
+ * @return 4x4 matrix as Q of the rectification
+ */
+cv::Mat SyntheticScene::depthMapping() const {
+    const cv::Mat& k = cams[0].camMat;
+    const double tx = cams[1].trnVec[0];
+    return (cv::Mat_<double>(4, 4) <<
+            1.0, 0.0, 0.0, -k.at<double>(0, 2),
+            0.0, 1.0, 0.0, -k.at<double>(1, 2),
+            0.0, 0.0, 0.0, k.at<double>(0, 0),
+            0.0, 0.0, -1.0 / tx, 0.0);
+}
+
+/**
+ * Save the cameras as the camera parameters in YAML
+ * The file is opened by the stereo camera.
+ * @param file name
+ */
+void SyntheticScene::saveCamera(const string& fn) const {
+    cv::FileStorage fs;
+    if (!fs.open(fn, cv::FileStorage::WRITE)) {
+        string msg("Could not write ");
+        msg += fn;
+        throw msg;
+    }
+    // the essential and the fundamental matrices from the rotation and the translation
+    const cv::Vec3d& t = cams[1].trnVec;
+    const cv::Matx33d tCross(0.0, -t[2], t[1], t[2], 0.0, -t[0], -t[1], t[0], 0.0);
+    cv::Mat essMat(tCross * cams[1].rotMat);
+    cv::Mat funMat = cams[1].camMat.inv().t() * essMat * cams[0].camMat.inv();
+    fs << "C1" << cams[0].camMat << "D1" << cams[0].dstCof
+       << "C2" << cams[1].camMat << "D2" << cams[1].dstCof
+       << "R" << cv::Mat(cams[1].rotMat) << "T" << cv::Mat(cams[1].trnVec)
+       << "E" << essMat << "F" << funMat;
+    fs.release();
+}
+
+/**
+ * Intersect the ray with the scene
+ * @param origin of the ray
+ * @param direction of the ray
+ * @param nearest intersection
+ * @return the ray hits the scene or not
+ */
+bool SyntheticScene::intersect(const cv::Vec3d& org, const cv::Vec3d& dir, cv::Vec3d& pt) const {
+    double tMin = DBL_MAX;
+    double den = plnNormal.dot(dir);
+    if (fabs(den) > DBL_EPSILON) {
+        double t = (plnDist - plnNormal.dot(org)) / den;
+        tMin = (t > 0.0 ? t : tMin);
+    }
+    const cv::Vec3d oc = org - sphCtr;
+    double a = dir.dot(dir), b = oc.dot(dir), c = oc.dot(oc) - sphRad * sphRad;
+    double disc = b * b - a * c;
+    if (disc >= 0.0) {
+        double t = (-b - sqrt(disc)) / a;
+        tMin = (t > 0.0 && t < tMin ? t : tMin);
+    }
+    if (tMin == DBL_MAX) {
+        return false;
+    }
+    pt = org + tMin * dir;
+    return true;
+}
+
+/**
+ * Get the color of the texture at the point
+ * The fine noise for the stereo matching is mixed with the coarse noise.
+ * @param point on the scene
+ * @return color in BGR
+ */
+cv::Vec3b SyntheticScene::texture(const cv::Vec3d& pt) const {
+    cv::Vec3b col;
+    for (int ch = 0; ch < 3; ch++) {
+        double val = 0.7 * noise(pt, cell, ch) + 0.3 * noise(pt, cell * 8.0, ch + 3);
+        col[ch] = cv::saturate_cast<uchar>(255.0 * val);
+    }
+    return col;
+}
+
+/**
+ * Get the value noise at the point
+ * The random values on the lattice are interpolated trilinearly.
+ * @param point
+ * @param size of the cell of the lattice
+ * @param channel of the noise
+ * @return value from 0 to 1
+ */
+double SyntheticScene::noise(const cv::Vec3d& pt, double cell, int ch) const {
+    int lat[3];
+    double frac[3];
+    for (int i = 0; i < 3; i++) {
+        double v = pt[i] / cell;
+        lat[i] = (int)floor(v);
+        frac[i] = v - lat[i];
+    }
+    auto random = [&](int x, int y, int z) {
+        uint32_t h = seed * 0x9e3779b9u ^ (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u
+                   ^ (uint32_t)z * 83492791u ^ (uint32_t)ch * 2654435761u;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return (h & 0xffff) / 65535.0;
+    };
+    double val = 0.0;
+    for (int i = 0; i < 8; i++) {
+        double w = 1.0;
+        for (int j = 0; j < 3; j++) {
+            w *= ((i >> j) & 1 ? frac[j] : 1.0 - frac[j]);
+        }
+        val += w * random(lat[0] + (i & 1), lat[1] + ((i >> 1) & 1), lat[2] + ((i >> 2) & 1));
+    }
+    return val;
+}
+
@@ -0,0 +1,65 @@
+/* 
+ * SyntheticScene Class
+ *  - The known textured 3D scene is rendered through the stereo camera
+ *    to test the construction at any resolution.
+ *  - The scene is the slanted plane with the sphere in front of it,
+ *    and its depths are in the search range of the disparity map.
+ *  - The cameras are the calibrated stereo camera scaled to the resolution,
+ *    or the rectified cameras with the synthetic intrinsic parameters.
+ *  - The depth of the left image is rendered as the ground truth.
+ * 
+ * File:   SyntheticScene.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:40 PM
+ */
+
+#ifndef SYNTHETICSCENE_H
+#define	SYNTHETICSCENE_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+class Image;
+class StereoCamera;
+
+class SyntheticScene {
+public:
+    SyntheticScene(const cv::Size& size, unsigned int seed = 0);
+    SyntheticScene(const cv::Size& size, const StereoCamera& sCam, const cv::Size& calibSize,
+                   unsigned int seed = 0);
+    virtual ~SyntheticScene();
+    // get the size of the images
+    cv::Size imageSize() const { return size; };
+    vector<Image> render(cv::Mat* depth = nullptr) const;
+    cv::Mat depthMapping() const;
+    void saveCamera(const string& fn) const;
+private:
+    // the camera in the coordinates of the left camera
+    struct Camera {
+        cv::Mat camMat, dstCof;     // intrinsic parameters and distortion coefficients
+        cv::Matx33d rotMat;         // rotation from the left camera
+        cv::Vec3d trnVec;           // translation from the left camera
+    };
+    // ratios of the disparities of the plane and the front of the sphere to the search range
+    static const double FARDISPARITY, NEARDISPARITY;
+    void setScene(unsigned int seed);
+    bool intersect(const cv::Vec3d& org, const cv::Vec3d& dir, cv::Vec3d& pt) const;
+    cv::Vec3b texture(const cv::Vec3d& pt) const;
+    double noise(const cv::Vec3d& pt, double cell, int ch) const;
+    cv::Size size;          // size of the images
+    Camera cams[2];         // left and right cameras
+    cv::Vec3d plnNormal;    // normal vector of the plane
+    double plnDist;         // distance of the plane from the left camera
+    cv::Vec3d sphCtr;       // center of the sphere
+    double sphRad;          // radius of the sphere
+    double cell;            // size of the cell of the texture
+    unsigned int seed;      // seed of the texture
+
+};
+
+#endif	/* SYNTHETICSCENE_H */
+
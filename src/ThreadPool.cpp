@@ -0,0 +1,154 @@
+/* 
+ * ThreadPool Class
+ *  - The tasks are run by the fixed number of the threads.
+ *  - Each thread has its own task queue, and the idle thread steals
+ *    the oldest task from the queues of the other threads.
+ *  - The task submitted by the task is pushed to the queue of its thread.
+ * 
+ * File:   ThreadPool.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#include "ThreadPool.h"
+
+// the pool and the index of the current thread
+static thread_local const ThreadPool* currPool = nullptr;
+static thread_local unsigned int currIdx = 0;
+
+/**
+ * Constructor and Destructor
+ * The destructor waits for the tasks.
+ * @param number of the threads
+ */
+ThreadPool::ThreadPool(unsigned int nThreads)
+: nQueued(0), nPending(0), next(0), stopping(false) {
+    nThreads = (nThreads > 0 ? nThreads : 1);
+    for (unsigned int i = 0; i < nThreads; i++) {
+        queues.push_back(unique_ptr<TaskQueue>(new TaskQueue));
+    }
+    for (unsigned int i = 0; i < nThreads; i++) {
+        threads.push_back(thread(&ThreadPool::work, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        unique_lock<mutex> lock(mtx);
+        idle.wait(lock, [&]() { return (nPending == 0); });
+        stopping = true;
+        ready.notify_all();
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/**
+ * Submit the task
+ * @param task
+ */
+void ThreadPool::submit(const function<void()>& task) {
+    unsigned int idx = 0;
+    {
+        // the task is counted before it is visible to the threads,
+        // otherwise the stolen task could be finished before it is counted
+        lock_guard<mutex> lock(mtx);
+        if (currPool == this) {
+            idx = currIdx;
+        } else {
+            idx = next;
+            next = (next + 1) % queues.size();
+        }
+        nQueued++;
+        nPending++;
+    }
+    {
+        lock_guard<mutex> lock(queues[idx]->mtx);
+        queues[idx]->tasks.push_back(task);
+    }
+    lock_guard<mutex> lock(mtx);
+    ready.notify_one();
+}
+
+/**
+ * Wait until all of the tasks are finished
+ * The first exception thrown by the tasks is rethrown.
+ */
+void ThreadPool::wait() {
+    unique_lock<mutex> lock(mtx);
+    idle.wait(lock, [&]() { return (nPending == 0); });
+    if (error) {
+        exception_ptr err = error;
+        error = nullptr;
+        rethrow_exception(err);
+    }
+}
+
+/**
+ * Take the task
+ * The newest task of the own queue is taken first,
+ * then the oldest task of the other queues is stolen.
+ * @param index of the thread
+ * @param taken task
+ * @return taken or not
+ */
+bool ThreadPool::take(unsigned int idx, function<void()>& task) {
+    {
+        TaskQueue& own = *queues[idx];
+        lock_guard<mutex> lock(own.mtx);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++) {
+        TaskQueue& other = *queues[(idx + i) % queues.size()];
+        lock_guard<mutex> lock(other.mtx);
+        if (!other.tasks.empty()) {
+            task = other.tasks.front();
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Run the tasks on the thread
+ * @param index of the thread
+ */
+void ThreadPool::work(unsigned int idx) {
+    currPool = this;
+    currIdx = idx;
+    while (true) {
+        function<void()> task;
+        if (take(idx, task)) {
+            {
+                lock_guard<mutex> lock(mtx);
+                nQueued--;
+            }
+            try {
+                task();
+            } catch (...) {
+                lock_guard<mutex> lock(mtx);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+            lock_guard<mutex> lock(mtx);
+            if (--nPending == 0) {
+                idle.notify_all();
+            }
+            continue;
+        }
+        unique_lock<mutex> lock(mtx);
+        ready.wait(lock, [&]() { return (stopping || nQueued > 0); });
+        if (stopping && nQueued <= 0) {
+            return;
+        }
+    }
+}
+
@@ -0,0 +1,58 @@
+/* 
+ * ThreadPool Class
+ *  - The tasks are run by the fixed number of the threads.
+ *  - Each thread has its own task queue, and the idle thread steals
+ *    the oldest task from the queues of the other threads.
+ *  - The task submitted by the task is pushed to the queue of its thread.
+ * 
+ * File:   ThreadPool.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#ifndef THREADPOOL_H
+#define	THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool {
+public:
+    ThreadPool(unsigned int nThreads);
+    virtual ~ThreadPool();
+    // get the number of the threads
+    unsigned int size() const { return threads.size(); };
+    void submit(const function<void()>& task);
+    void wait();
+private:
+    // the task queue of the thread
+    struct TaskQueue {
+        mutex mtx;                      // mutex of the tasks
+        deque<function<void()>> tasks;  // tasks
+    };
+    void work(unsigned int idx);
+    bool take(unsigned int idx, function<void()>& task);
+    vector<unique_ptr<TaskQueue>> queues;   // task queues of the threads
+    vector<thread> threads;         // threads
+    mutex mtx;                      // mutex of the counters
+    condition_variable ready;       // condition that the task is queued or the pool is stopped
+    condition_variable idle;        // condition that all of the tasks are finished
+    long nQueued;                   // number of the tasks in the queues
+    long nPending;                  // number of the tasks that are not finished
+    unsigned int next;              // next queue to submit the task from the outside
+    bool stopping;                  // the pool is stopping or not
+    exception_ptr error;            // first exception thrown by the tasks
+
+};
+
+#endif	/* THREADPOOL_H */
+
@@ -0,0 +1,216 @@
+/* 
+ * Trace Class
+ *  - The scoped events are recorded to trace where the time goes.
+ *  - The events are recorded in the buffer of each thread without the lock,
+ *    and dumped in the Chrome trace JSON, which is read by Perfetto.
+ *  - The tracing is enabled by the environment variable RPRJ3D_TRACE,
+ *    which is the file name to dump the events at exit, or by enable.
+ *  - The events are compiled out without RPRJ3D_TRACE macro,
+ *    and they cost a flag check while the tracing is disabled.
+ * 
+ * File:   Trace.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:30 PM
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include "Trace.h"
+
+const size_t Trace::MAXOFEVENTS = 1 << 16;
+atomic<bool> Trace::enabled(false);
+mutex Trace::bufsMtx;
+vector<shared_ptr<Trace::Buffer>> Trace::bufs;
+set<string> Trace::names;
+
+namespace {
+    // the start time of the trace
+    const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+
+    // the tracing is enabled by the environment variable, and the events are dumped at exit
+    struct TraceFile {
+        TraceFile() : fn(getenv("RPRJ3D_TRACE") ? getenv("RPRJ3D_TRACE") : "") {
+            if (!fn.empty()) {
+                Trace::enable(true);
+            }
+        }
+        ~TraceFile() {
+            if (!fn.empty()) {
+                try {
+                    Trace::save(fn);
+                } catch (const string& msg) {
+                }
+            }
+        }
+        string fn;  // file name to dump the events
+    } traceFile;
+}
+
+/**
+ * Enable or disable the tracing
+ * @param enabled or not
+ */
+void Trace::enable(bool enabled) {
+    Trace::enabled.store(enabled, memory_order_relaxed);
+}
+
+/**
+ * Get the time since the start of the trace
+ * @return time in microseconds
+ */
+int64_t Trace::now() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+/**
+ * Get the buffer of the calling thread
+ * The buffer is taken when the thread begins the event first.
+ * The buffer released by the ended thread is taken if any,
+ * otherwise the new buffer is registered.
+ * The events in the buffer are kept after the thread is ended.
+ * @return buffer
+ */
+Trace::Buffer& Trace::buffer() {
+    thread_local Owner owner;
+    if (!owner.buf) {
+        lock_guard<mutex> lock(bufsMtx);
+        auto it = find_if(bufs.begin(), bufs.end(), [](const shared_ptr<Buffer>& buf) {
+            return !buf->used;
+        });
+        if (it != bufs.end()) {
+            (*it)->used = true;
+            owner.buf = it->get();
+        } else {
+            bufs.push_back(shared_ptr<Buffer>(new Buffer(bufs.size() + 1)));
+            owner.buf = bufs.back().get();
+        }
+    }
+    return *owner.buf;
+}
+
+/**
+ * Release the buffer at the end of the thread
+ */
+Trace::Owner::~Owner() {
+    if (buf) {
+        lock_guard<mutex> lock(bufsMtx);
+        buf->used = false;
+    }
+}
+
+/**
+ * Begin the event on the calling thread
+ * The buffer is taken before the start time,
+ * then the events of the threads that share the buffer do not overlap.
+ * @return start time in microseconds
+ */
+int64_t Trace::begin() {
+    buffer();
+    return now();
+}
+
+/**
+ * Record the event
+ * The event is dropped if the buffer of the thread is full.
+ * @param name of the event
+ * @param start time in microseconds
+ * @param duration in microseconds
+ */
+void Trace::record(const char* name, int64_t start, int64_t dur) {
+    Buffer& buf = buffer();
+    size_t n = buf.count.load(memory_order_relaxed);
+    if (n >= buf.events.size()) {
+        buf.dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    Event& ev = buf.events[n];
+    ev.name = name;
+    ev.start = start;
+    ev.dur = dur;
+    // the event is visible to dump after it is written
+    buf.count.store(n + 1, memory_order_release);
+}
+
+/**
+ * Intern the name of the event
+ * The name is kept until the exit, then it is used for the events
+ * instead of the string that may be destroyed before dumping.
+ * @param name of the event
+ * @return interned name
+ */
+const char* Trace::intern(const string& name) {
+    lock_guard<mutex> lock(bufsMtx);
+    return names.insert(name).first->c_str();
+}
+
+/**
+ * Dump the events in the Chrome trace JSON
+ * The events that are recorded while dumping may not be dumped.
+ * @param output stream
+ */
+void Trace::dump(ostream& os) {
+    vector<shared_ptr<Buffer>> bufs;
+    {
+        lock_guard<mutex> lock(bufsMtx);
+        bufs = Trace::bufs;
+    }
+    auto escape = [](const char* str) {
+        string esc;
+        for (; *str; str++) {
+            if (*str == '"' || *str == '\\') {
+                esc += '\\';
+            }
+            esc += *str;
+        }
+        return esc;
+    };
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for_each(bufs.begin(), bufs.end(), [&](const shared_ptr<Buffer>& buf) {
+        size_t n = buf->count.load(memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            const Event& ev = buf->events[i];
+            os << (first ? "\n" : ",\n")
+               << "{\"name\":\"" << escape(ev.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buf->tid
+               << ",\"ts\":" << ev.start << ",\"dur\":" << ev.dur << "}";
+            first = false;
+        }
+        if (buf->dropped > 0) {
+            os << (first ? "\n" : ",\n")
+               << "{\"name\":\"dropped " << buf->dropped << " events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+               << buf->tid << ",\"ts\":" << now() << "}";
+            first = false;
+        }
+    });
+    os << "\n]}\n";
+}
+
+/**
+ * Save the events to the file in the Chrome trace JSON
+ * @param file name
+ */
+void Trace::save(const string& fn) {
+    ofstream file(fn.c_str());
+    if (!file) {
+        string msg("Could not write ");
+        msg += fn;
+        throw msg;
+    }
+    dump(file);
+}
+
+/**
+ * Clear the events
+ * The events must not be recorded while clearing.
+ */
+void Trace::clear() {
+    lock_guard<mutex> lock(bufsMtx);
+    for_each(bufs.begin(), bufs.end(), [](const shared_ptr<Buffer>& buf) {
+        buf->count = 0;
+        buf->dropped = 0;
+    });
+}
+
@@ -0,0 +1,96 @@
+/* 
+ * Trace Class
+ *  - The scoped events are recorded to trace where the time goes.
+ *  - The events are recorded in the buffer of each thread without the lock,
+ *    and dumped in the Chrome trace JSON, which is read by Perfetto.
+ *  - The buffer of the ended thread is reused by the next new thread,
+ *    then the short-lived threads share the buffers and the thread IDs.
+ *  - The tracing is enabled by the environment variable RPRJ3D_TRACE,
+ *    which is the file name to dump the events at exit, or by enable.
+ *  - The events are compiled out without RPRJ3D_TRACE macro,
+ *    and they cost a flag check while the tracing is disabled.
+ * 
+ * File:   Trace.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 10:30 PM
+ */
+
+#ifndef TRACE_H
+#define	TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#ifdef RPRJ3D_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// record the event from here to the end of the scope
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+class Trace {
+public:
+    // the event from the construction to the destruction
+    class Scope {
+    public:
+        Scope(const char* name) : name(Trace::isEnabled() ? name : nullptr), start(this->name ? Trace::begin() : 0) {};
+        ~Scope() { if (name) Trace::record(name, start, Trace::now() - start); };
+    private:
+        const char* name;   // name of the event, or null if the tracing is disabled
+        int64_t start;      // start time in microseconds
+    };
+    // maximum number of the events in the buffer of each thread
+    static const size_t MAXOFEVENTS;
+    // verify whether the tracing is enabled
+    static bool isEnabled() { return enabled.load(memory_order_relaxed); };
+    static void enable(bool enabled);
+    static int64_t now();
+    static void record(const char* name, int64_t start, int64_t dur);
+    static const char* intern(const string& name);
+    static void dump(ostream& os);
+    static void save(const string& fn);
+    static void clear();
+private:
+    // the complete event
+    struct Event {
+        const char* name;   // name, which must live until the events are dumped
+        int64_t start;      // start time in microseconds
+        int64_t dur;        // duration in microseconds
+    };
+    // the buffer of the thread, which is written only by the thread
+    struct Buffer {
+        Buffer(int tid) : tid(tid), events(MAXOFEVENTS), count(0), dropped(0), used(true) {};
+        int tid;                        // thread ID in the trace
+        vector<Event> events;           // events
+        atomic<size_t> count;           // number of the recorded events
+        atomic<size_t> dropped;         // number of the dropped events
+        bool used;                      // the buffer is used by the thread or not
+    };
+    // the owner of the buffer in the thread, which releases the buffer at the end of the thread
+    struct Owner {
+        Owner() : buf(nullptr) {};
+        ~Owner();
+        Buffer* buf;                    // buffer of the thread, or null
+    };
+    static Buffer& buffer();
+    static int64_t begin();
+    static atomic<bool> enabled;        // the tracing is enabled or not
+    static mutex bufsMtx;               // mutex of the buffers
+    static vector<shared_ptr<Buffer>> bufs; // buffers of all the threads
+    static set<string> names;           // names of the events that are not the literals
+
+};
+
+#endif	/* TRACE_H */
+
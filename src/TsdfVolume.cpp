@@ -0,0 +1,362 @@
+/* 
+ * TsdfVolume Class
+ *  - The depth maps of the stereo captures are fused
+ *    into the truncated signed distance field.
+ *  - The voxels are allocated in the blocks hashed by their coordinates
+ *    only around the observed surface, then the memory scales with the surface.
+ *  - The blocks along the rays are allocated, and the voxels of the blocks
+ *    are updated in parallel by projecting them to the depth map.
+ *  - The polygon mesh is extracted by the marching cubes,
+ *    whose cubes are divided into the tetrahedra.
+ * 
+ * File:   TsdfVolume.cpp
+ * Author: munehiro
+ * 
+ * Created on October 19, 2026, 12:10 AM
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+#include "TsdfVolume.h"
+#include "Image.h"
+#include "Vertex.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+const double TsdfVolume::VOXELSIZE  = 2.0;
+const double TsdfVolume::TRUNCATION = 8.0;
+const float TsdfVolume::MAXWEIGHT   = 64.0f;
+
+/**
+ * Constructor and Destructor
+ * @param size of the voxel in millimeters
+ * @param truncation of the signed distance in millimeters
+ * @param maximum depth of the captures in millimeters
+ */
+TsdfVolume::TsdfVolume(double voxelSize, double truncation, double maxDepth)
+: voxelSize(voxelSize), trunc(truncation), maxDepth(maxDepth) {
+    if (voxelSize <= 0.0 || truncation < voxelSize || maxDepth <= 0.0) {
+        throw string("Invalid volume");
+    }
+}
+
+TsdfVolume::~TsdfVolume() {
+}
+
+/**
+ * Get the memory of the allocated blocks
+ * @return bytes including the hash table
+ */
+size_t TsdfVolume::memoryBytes() const {
+    // a node of the hash table has the key, the pointer and the link
+    size_t node = sizeof(BlockKey) + sizeof(unique_ptr<Block>) + sizeof(void*);
+    return blocks.size() * (sizeof(Block) + node) + blocks.bucket_count() * sizeof(void*);
+}
+
+/**
+ * Integrate the depth map of the stereo capture
+ * @param disparity map as CV_32F
+ * @param rectified left image
+ * @param disparity-to-depth mapping matrix
+ * @param pose from the camera to the volume
+ */
+void TsdfVolume::integrate(const Image& disp, const Image& img, const cv::Mat& qMat, const cv::Matx44d& pose) {
+    TRACE_SCOPE("tsdf.integrate");
+    if (disp.isEmpty() || disp.size() != img.size()) {
+        throw string("Image is empty");
+    }
+    cv::Mat pts, q;
+    cv::reprojectImageTo3D(disp.image(), pts, qMat);
+    qMat.convertTo(q, CV_64F);
+    // the intrinsic parameters of the rectified left camera
+    const double f = q.at<double>(2, 3), cx = -q.at<double>(0, 3), cy = -q.at<double>(1, 3);
+    const cv::Matx33d rot(pose(0, 0), pose(0, 1), pose(0, 2),
+                          pose(1, 0), pose(1, 1), pose(1, 2),
+                          pose(2, 0), pose(2, 1), pose(2, 2));
+    const cv::Vec3d trn(pose(0, 3), pose(1, 3), pose(2, 3));
+    auto isValid = [&](float z) { return (z > 0.0f && z <= maxDepth); };
+    // allocate the blocks along the rays in the truncation band
+    unordered_set<BlockKey, BlockHash> visible;
+    mutex mtx;
+    const int nSteps = (int)ceil(4.0 * trunc / (voxelSize * BLOCKSIZE));
+    Parallel::range(pts.rows, [&](size_t begin, size_t end) {
+        unordered_set<BlockKey, BlockHash> keys;
+        for (size_t v = begin; v < end; v++) {
+            const cv::Vec3f* row = pts.ptr<cv::Vec3f>(v);
+            for (int u = 0; u < pts.cols; u++) {
+                if (!isValid(row[u][2])) {
+                    continue;
+                }
+                const cv::Vec3d pt(row[u][0], row[u][1], row[u][2]);
+                const cv::Vec3d dir = pt * (1.0 / cv::norm(pt));
+                for (int i = 0; i <= nSteps; i++) {
+                    double s = trunc * (2.0 * i / nSteps - 1.0);
+                    keys.insert(blockOf(rot * (pt + s * dir) + trn));
+                }
+            }
+        }
+        lock_guard<mutex> lock(mtx);
+        visible.insert(keys.begin(), keys.end());
+    }, 16);
+    vector<BlockKey> keys(visible.begin(), visible.end());
+    vector<Block*> blks;
+    blks.reserve(keys.size());
+    for_each(keys.begin(), keys.end(), [&](const BlockKey& key) {
+        unique_ptr<Block>& blk = blocks[key];
+        if (!blk) {
+            blk.reset(new Block);
+            for_each(blk->voxels, blk->voxels + BLOCKSIZE * BLOCKSIZE * BLOCKSIZE, [](Voxel& vox) {
+                vox.sdf = 1.0f;
+                vox.weight = 0.0f;
+                fill_n(vox.color, 3, 0);
+            });
+        }
+        blks.push_back(blk.get());
+    });
+    // update the voxels of the visible blocks, which are not shared by the threads
+    const cv::Matx33d rotInv = rot.t();
+    const cv::Vec3d trnInv = -(rotInv * trn);
+    const cv::Mat& col = img.image();
+    Parallel::range(blks.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const BlockKey& key = keys[i];
+            Voxel* vox = blks[i]->voxels;
+            for (int z = 0; z < BLOCKSIZE; z++) {
+                for (int y = 0; y < BLOCKSIZE; y++) {
+                    for (int x = 0; x < BLOCKSIZE; x++, vox++) {
+                        const cv::Vec3d ctr((key.x * BLOCKSIZE + x + 0.5) * voxelSize,
+                                            (key.y * BLOCKSIZE + y + 0.5) * voxelSize,
+                                            (key.z * BLOCKSIZE + z + 0.5) * voxelSize);
+                        const cv::Vec3d c = rotInv * ctr + trnInv;
+                        if (c[2] <= 0.0) {
+                            continue;
+                        }
+                        int u = cvRound(f * c[0] / c[2] + cx);
+                        int v = cvRound(f * c[1] / c[2] + cy);
+                        if (u < 0 || u >= pts.cols || v < 0 || v >= pts.rows) {
+                            continue;
+                        }
+                        float depth = pts.at<cv::Vec3f>(v, u)[2];
+                        if (!isValid(depth) || depth - c[2] < -trunc) {
+                            continue;
+                        }
+                        // the running average of the signed distance and the color
+                        float sdf = (float)min(1.0, (depth - c[2]) / trunc);
+                        float weight = vox->weight + 1.0f;
+                        vox->sdf = (vox->sdf * vox->weight + sdf) / weight;
+                        const cv::Vec3b& bgr = col.at<cv::Vec3b>(v, u);
+                        for (int ch = 0; ch < 3; ch++) {
+                            vox->color[ch] = (uchar)((vox->color[ch] * vox->weight + bgr[2-ch]) / weight + 0.5f);
+                        }
+                        vox->weight = min(weight, MAXWEIGHT);
+                    }
+                }
+            }
+        }
+    }, 1);
+}
+
+/**
+ * Extract the polygon mesh on the zero crossing of the signed distance field
+ * Each cube of the voxels is divided into 6 tetrahedra around its diagonal,
+ * then the mesh has no ambiguous case and no hole between the cubes.
+ * The mesh is in the coordinates of the point cloud, whose y axis is flipped
+ * and whose z axis is the distance from the maximum depth.
+ * @param vertices with the normal vectors
+ * @param vertex indexes of the triangles, 3 indexes per triangle
+ */
+void TsdfVolume::extractMesh(vector<Vertex>& vtcs, vector<uint32_t>& idxs) const {
+    TRACE_SCOPE("tsdf.extract");
+    // the vertex is identified by the edge between the voxels
+    struct EdgeKey {
+        uint64_t a, b;  // packed coordinates of the voxels, a < b
+        bool operator==(const EdgeKey& key) const { return (a == key.a && b == key.b); };
+    };
+    struct EdgeHash {
+        size_t operator()(const EdgeKey& key) const { return (size_t)(key.a * 0x9e3779b97f4a7c15ULL ^ key.b); };
+    };
+    struct TriVertex {
+        EdgeKey edge;       // edge of the vertex
+        cv::Vec3d pos;      // position in the voxels
+        cv::Vec3d col;      // color in RGB
+    };
+    static const int corners[8][3] = {
+        { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+    };
+    static const int tets[6][4] = {
+        { 0, 5, 1, 6 }, { 0, 1, 2, 6 }, { 0, 2, 3, 6 }, { 0, 3, 7, 6 }, { 0, 7, 4, 6 }, { 0, 4, 5, 6 }
+    };
+    auto pack = [](const int* g) {
+        const uint64_t ofs = 1 << 20, mask = (1 << 21) - 1;
+        return ((g[0] + ofs) & mask) << 42 | ((g[1] + ofs) & mask) << 21 | ((g[2] + ofs) & mask);
+    };
+    vector<pair<BlockKey, const Block*>> blks;
+    blks.reserve(blocks.size());
+    for_each(blocks.begin(), blocks.end(), [&](const pair<const BlockKey, unique_ptr<Block>>& blk) {
+        blks.push_back(make_pair(blk.first, blk.second.get()));
+    });
+    // the triangles of each block, 3 vertices per triangle
+    vector<TriVertex> tris;
+    mutex mtx;
+    Parallel::range(blks.size(), [&](size_t begin, size_t end) {
+        vector<TriVertex> local;
+        for (size_t i = begin; i < end; i++) {
+            const BlockKey& key = blks[i].first;
+            const Block& blk = *blks[i].second;
+            for (int z = 0; z < BLOCKSIZE; z++) {
+                for (int y = 0; y < BLOCKSIZE; y++) {
+                    for (int x = 0; x < BLOCKSIZE; x++) {
+                        // the cube of the observed voxels across the surface
+                        const Voxel* vox[8];
+                        int g[8][3];
+                        bool isObserved = true, hasIn = false, hasOut = false;
+                        for (int c = 0; c < 8 && isObserved; c++) {
+                            vox[c] = voxel(key, blk, x + corners[c][0], y + corners[c][1], z + corners[c][2]);
+                            isObserved = (vox[c] && vox[c]->weight > 0.0f);
+                            if (isObserved) {
+                                (vox[c]->sdf < 0.0f ? hasIn : hasOut) = true;
+                            }
+                        }
+                        if (!isObserved || !hasIn || !hasOut) {
+                            continue;
+                        }
+                        for (int c = 0; c < 8; c++) {
+                            g[c][0] = key.x * BLOCKSIZE + x + corners[c][0];
+                            g[c][1] = key.y * BLOCKSIZE + y + corners[c][1];
+                            g[c][2] = key.z * BLOCKSIZE + z + corners[c][2];
+                        }
+                        auto vertexOn = [&](int p, int q) {
+                            TriVertex tv;
+                            uint64_t kp = pack(g[p]), kq = pack(g[q]);
+                            tv.edge.a = min(kp, kq);
+                            tv.edge.b = max(kp, kq);
+                            double t = vox[p]->sdf / (vox[p]->sdf - vox[q]->sdf);
+                            for (int j = 0; j < 3; j++) {
+                                tv.pos[j] = g[p][j] + t * (g[q][j] - g[p][j]);
+                                tv.col[j] = vox[p]->color[j] + t * (vox[q]->color[j] - vox[p]->color[j]);
+                            }
+                            return tv;
+                        };
+                        for (int t = 0; t < 6; t++) {
+                            int in[4], out[4], nIn = 0, nOut = 0;
+                            for (int j = 0; j < 4; j++) {
+                                int c = tets[t][j];
+                                if (vox[c]->sdf < 0.0f) {
+                                    in[nIn++] = c;
+                                } else {
+                                    out[nOut++] = c;
+                                }
+                            }
+                            if (nIn == 0 || nOut == 0) {
+                                continue;
+                            }
+                            // the direction from the inside to the outside to orient the triangles
+                            cv::Vec3d dir(0.0, 0.0, 0.0);
+                            for (int j = 0; j < nOut; j++) {
+                                dir += cv::Vec3d(g[out[j]][0], g[out[j]][1], g[out[j]][2]) * (1.0 / nOut);
+                            }
+                            for (int j = 0; j < nIn; j++) {
+                                dir -= cv::Vec3d(g[in[j]][0], g[in[j]][1], g[in[j]][2]) * (1.0 / nIn);
+                            }
+                            auto emit = [&](const TriVertex& a, const TriVertex& b, const TriVertex& c) {
+                                bool isFlipped = ((b.pos - a.pos).cross(c.pos - a.pos).dot(dir) < 0.0);
+                                local.push_back(a);
+                                local.push_back(isFlipped ? c : b);
+                                local.push_back(isFlipped ? b : c);
+                            };
+                            if (nIn == 2) {
+                                TriVertex e[] = { vertexOn(in[0], out[0]), vertexOn(in[0], out[1]),
+                                                  vertexOn(in[1], out[1]), vertexOn(in[1], out[0]) };
+                                emit(e[0], e[1], e[2]);
+                                emit(e[0], e[2], e[3]);
+                            } else {
+                                // the lone vertex inside or outside
+                                int lone = (nIn == 1 ? in[0] : out[0]);
+                                const int* others = (nIn == 1 ? out : in);
+                                emit(vertexOn(lone, others[0]), vertexOn(lone, others[1]), vertexOn(lone, others[2]));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        lock_guard<mutex> lock(mtx);
+        tris.insert(tris.end(), local.begin(), local.end());
+    }, 1);
+    // weld the vertices on the same edge
+    unordered_map<EdgeKey, uint32_t, EdgeHash> idxOf;
+    idxOf.reserve(tris.size() / 3);
+    vector<const TriVertex*> uniq;
+    idxs.clear();
+    idxs.reserve(tris.size());
+    for_each(tris.begin(), tris.end(), [&](const TriVertex& tv) {
+        auto it = idxOf.insert(make_pair(tv.edge, (uint32_t)uniq.size()));
+        if (it.second) {
+            uniq.push_back(&tv);
+        }
+        idxs.push_back(it.first->second);
+    });
+    // the normal vectors are the area weighted normals of the triangles
+    vector<cv::Vec3d> nmls(uniq.size(), cv::Vec3d(0.0, 0.0, 0.0));
+    for (size_t i = 0; i + 2 < idxs.size(); i += 3) {
+        const cv::Vec3d& p0 = uniq[idxs[i]]->pos;
+        cv::Vec3d n = (uniq[idxs[i+1]]->pos - p0).cross(uniq[idxs[i+2]]->pos - p0);
+        for (int j = 0; j < 3; j++) {
+            nmls[idxs[i+j]] += n;
+        }
+    }
+    vtcs.assign(uniq.size(), Vertex());
+    for (size_t i = 0; i < uniq.size(); i++) {
+        const cv::Vec3d& pos = uniq[i]->pos;
+        const cv::Vec3d& col = uniq[i]->col;
+        double len = cv::norm(nmls[i]);
+        cv::Vec3d n = (len > 0.0 ? nmls[i] * (1.0 / len) : cv::Vec3d(0.0, 0.0, -1.0));
+        vtcs[i].setPosition((pos[0] + 0.5) * voxelSize, -(pos[1] + 0.5) * voxelSize,
+                            maxDepth - (pos[2] + 0.5) * voxelSize);
+        vtcs[i].setNormal(n[0], -n[1], -n[2]);
+        vtcs[i].setColor((uchar)(col[0] + 0.5), (uchar)(col[1] + 0.5), (uchar)(col[2] + 0.5));
+    }
+}
+
+/**
+ * Clear the volume
+ */
+void TsdfVolume::clear() {
+    blocks.clear();
+}
+
+/**
+ * Get the block that contains the point
+ * @param point in millimeters
+ * @return coordinates of the block
+ */
+TsdfVolume::BlockKey TsdfVolume::blockOf(const cv::Vec3d& pt) const {
+    const double size = voxelSize * BLOCKSIZE;
+    BlockKey key = { (int)floor(pt[0] / size), (int)floor(pt[1] / size), (int)floor(pt[2] / size) };
+    return key;
+}
+
+/**
+ * Get the voxel by the coordinates from the block
+ * The voxel in the neighbor block is searched if the coordinates are out of the block.
+ * @param coordinates of the block
+ * @param block
+ * @param x coordinate of the voxel in the block
+ * @param y coordinate of the voxel in the block
+ * @param z coordinate of the voxel in the block
+ * @return voxel, or null if the neighbor block is not allocated
+ */
+const TsdfVolume::Voxel* TsdfVolume::voxel(const BlockKey& key, const Block& blk, int x, int y, int z) const {
+    if (x < BLOCKSIZE && y < BLOCKSIZE && z < BLOCKSIZE) {
+        return &blk.voxels[(z * BLOCKSIZE + y) * BLOCKSIZE + x];
+    }
+    BlockKey nbr = { key.x + x / BLOCKSIZE, key.y + y / BLOCKSIZE, key.z + z / BLOCKSIZE };
+    auto it = blocks.find(nbr);
+    if (it == blocks.end()) {
+        return nullptr;
+    }
+    return &it->second->voxels[((z % BLOCKSIZE) * BLOCKSIZE + y % BLOCKSIZE) * BLOCKSIZE + x % BLOCKSIZE];
+}
+
@@ -0,0 +1,81 @@
+/* 
+ * TsdfVolume Class
+ *  - The depth maps of the stereo captures are fused
+ *    into the truncated signed distance field.
+ *  - The voxels are allocated in the blocks hashed by their coordinates
+ *    only around the observed surface, then the memory scales with the surface.
+ *  - The blocks along the rays are allocated, and the voxels of the blocks
+ *    are updated in parallel by projecting them to the depth map.
+ *  - The polygon mesh is extracted by the marching cubes,
+ *    whose cubes are divided into the tetrahedra.
+ * 
+ * File:   TsdfVolume.h
+ * Author: munehiro
+ * 
+ * Created on October 19, 2026, 12:10 AM
+ */
+
+#ifndef TSDFVOLUME_H
+#define	TSDFVOLUME_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+using namespace std;
+
+class Image;
+class Vertex;
+
+class TsdfVolume {
+public:
+    // number of the voxels on the side of the block
+    static const int BLOCKSIZE = 8;
+    // the voxel of the signed distance field
+    struct Voxel {
+        float sdf;          // signed distance divided by the truncation, positive in front of the surface
+        float weight;       // weight of the observations, 0 if the voxel is not observed
+        uchar color[3];     // color in RGB
+    };
+    // default size of the voxel and truncation of the signed distance in millimeters
+    static const double VOXELSIZE, TRUNCATION;
+    TsdfVolume(double voxelSize = VOXELSIZE, double truncation = TRUNCATION, double maxDepth = 1000.0);
+    virtual ~TsdfVolume();
+    // get the number of the allocated blocks
+    size_t nBlocks() const { return blocks.size(); };
+    size_t memoryBytes() const;
+    void integrate(const Image& disp, const Image& img, const cv::Mat& qMat,
+                   const cv::Matx44d& pose = cv::Matx44d::eye());
+    void extractMesh(vector<Vertex>& vtcs, vector<uint32_t>& idxs) const;
+    void clear();
+private:
+    // maximum weight of the voxel, which keeps the volume adaptive to the new captures
+    static const float MAXWEIGHT;
+    // coordinates of the block
+    struct BlockKey {
+        int x, y, z;
+        bool operator==(const BlockKey& key) const { return (x == key.x && y == key.y && z == key.z); };
+    };
+    // hash of the coordinates of the block
+    struct BlockHash {
+        size_t operator()(const BlockKey& key) const {
+            return ((size_t)key.x * 73856093u) ^ ((size_t)key.y * 19349663u) ^ ((size_t)key.z * 83492791u);
+        };
+    };
+    // the block of the voxels
+    struct Block {
+        Voxel voxels[BLOCKSIZE * BLOCKSIZE * BLOCKSIZE];
+    };
+    BlockKey blockOf(const cv::Vec3d& pt) const;
+    const Voxel* voxel(const BlockKey& key, const Block& blk, int x, int y, int z) const;
+    double voxelSize;       // size of the voxel in millimeters
+    double trunc;           // truncation of the signed distance in millimeters
+    double maxDepth;        // maximum depth of the captures in millimeters
+    unordered_map<BlockKey, unique_ptr<Block>, BlockHash> blocks;   // allocated blocks
+
+};
+
+#endif	/* TSDFVOLUME_H */
+
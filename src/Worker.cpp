@@ -0,0 +1,153 @@
+/* 
+ * Worker Class
+ *  - The job is run by the background thread.
+ *  - The function is invoked on the main thread by the job,
+ *    while the job waits for it, through Glib::Dispatcher.
+ *  - The job is cancelled when the next job is started,
+ *    and it stops at the next checkpoint.
+ *  - The next job waits for the cancelled job to exit on its thread,
+ *    then the jobs do not run at the same time.
+ * 
+ * File:   Worker.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 6:10 PM
+ */
+
+#include <algorithm>
+#include "Worker.h"
+
+const string Worker::CANCELLED("Cancelled");
+
+/**
+ * Constructor of the job
+ * @param worker that runs the job
+ */
+Worker::Job::Job(Worker* wkr) : wkr(wkr), cancelled(false), finished(false), invoking(false) {
+}
+
+/**
+ * Stop the job if it is cancelled
+ * The message CANCELLED is thrown.
+ */
+void Worker::Job::checkpoint() const {
+    if (cancelled) {
+        throw CANCELLED;
+    }
+}
+
+/**
+ * Invoke the function on the main thread and wait for it
+ * The message CANCELLED is thrown, if the job is cancelled before invoking.
+ * @param function
+ */
+void Worker::Job::invoke(const function<void()>& fn) {
+    unique_lock<mutex> lock(wkr->mtx);
+    checkpoint();
+    pending = fn;
+    wkr->dispatcher.emit();
+    wkr->cond.wait(lock, [&]() { return (!pending || cancelled); });
+    if (pending) {
+        pending = nullptr;
+        throw CANCELLED;
+    }
+}
+
+/**
+ * Constructor and Destructor
+ * The worker must be constructed on the main thread.
+ */
+Worker::Worker() {
+    dispatcher.connect(sigc::mem_fun(*this, &Worker::onDispatch));
+}
+
+Worker::~Worker() {
+    cancel();
+    for_each(jobs.begin(), jobs.end(), [](pair<shared_ptr<Job>, thread>& job) {
+        job.second.join();
+    });
+}
+
+/**
+ * Start the job
+ * The current job is cancelled, and the new job waits for the last job
+ * to exit on its thread, which does not block the main thread.
+ * The job is not run if it is cancelled while waiting.
+ * @param function of the job
+ */
+void Worker::start(const function<void(Job&)>& fn) {
+    cancel();
+    shared_ptr<Job> job(new Job(this));
+    shared_ptr<Job> prev = (jobs.empty() ? nullptr : jobs.back().first);
+    curr = job;
+    jobs.push_back(make_pair(job, thread([this, job, prev, fn]() {
+        if (prev) {
+            // the last job waits for its previous job in turn, even if it is cancelled
+            unique_lock<mutex> lock(mtx);
+            cond.wait(lock, [&]() { return (bool)prev->finished; });
+        }
+        try {
+            if (!job->cancelled) {
+                fn(*job);
+            }
+        } catch (...) {
+        }
+        {
+            lock_guard<mutex> lock(mtx);
+            job->finished = true;
+            cond.notify_all();
+        }
+        dispatcher.emit();
+    })));
+}
+
+/**
+ * Cancel the current job
+ * The job waiting for the main thread is released at once.
+ */
+void Worker::cancel() {
+    if (!curr) {
+        return;
+    }
+    lock_guard<mutex> lock(mtx);
+    curr->cancelled = true;
+    curr.reset();
+    cond.notify_all();
+}
+
+/**
+ * On dispatch from the jobs
+ * The pending function of the job is invoked, and the finished threads are joined.
+ * The function in progress is not invoked again by the dispatch
+ * from the nested main loop, such as of the dialog.
+ */
+void Worker::onDispatch() {
+    shared_ptr<Job> job = curr;
+    function<void()> fn;
+    if (job) {
+        lock_guard<mutex> lock(mtx);
+        if (!job->cancelled && !job->invoking) {
+            fn = job->pending;
+            job->invoking = (bool)fn;
+        }
+    }
+    if (fn) {
+        fn();
+        lock_guard<mutex> lock(mtx);
+        job->pending = nullptr;
+        job->invoking = false;
+        cond.notify_all();
+    }
+    for (auto it = jobs.begin(); it != jobs.end(); ) {
+        if (it->first->finished) {
+            it->second.join();
+            if (it->first == curr) {
+                curr.reset();
+            }
+            it = jobs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
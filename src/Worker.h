@@ -0,0 +1,69 @@
+/* 
+ * Worker Class
+ *  - The job is run by the background thread.
+ *  - The function is invoked on the main thread by the job,
+ *    while the job waits for it, through Glib::Dispatcher.
+ *  - The job is cancelled when the next job is started,
+ *    and it stops at the next checkpoint.
+ *  - The next job waits for the cancelled job to exit on its thread,
+ *    then the jobs do not run at the same time.
+ * 
+ * File:   Worker.h
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 6:10 PM
+ */
+
+#ifndef WORKER_H
+#define	WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <glibmm-2.4/glibmm.h>
+
+using namespace std;
+
+class Worker {
+public:
+    // message of the exception when the job is cancelled
+    static const string CANCELLED;
+    // the job run by the background thread
+    class Job {
+    public:
+        // verify whether the job is cancelled
+        bool isCancelled() const { return cancelled; };
+        void checkpoint() const;
+        void invoke(const function<void()>& fn);
+    private:
+        friend class Worker;
+        Job(Worker* wkr);
+        Worker* wkr;                // worker that runs the job
+        atomic<bool> cancelled;     // the job is cancelled or not
+        atomic<bool> finished;      // the thread of the job is finished or not
+        function<void()> pending;   // function to be invoked on the main thread
+        bool invoking;              // the pending function is being invoked or not
+    };
+    Worker();
+    virtual ~Worker();
+    // verify whether the job is running
+    bool isBusy() const { return (bool)curr; };
+    void start(const function<void(Job&)>& fn);
+    void cancel();
+private:
+    void onDispatch();
+    Glib::Dispatcher dispatcher;    // dispatcher to the main thread
+    mutex mtx;                      // mutex of the pending functions
+    condition_variable cond;        // condition that the pending function is invoked or the job is finished
+    shared_ptr<Job> curr;           // current job, or null
+    list<pair<shared_ptr<Job>, thread>> jobs;   // jobs whose threads are not joined
+
+};
+
+#endif	/* WORKER_H */
+
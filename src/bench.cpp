@@ -0,0 +1,436 @@
+/* 
+ * The main routine of the benchmark.
+ *  - The stages of the construction and the rendering are timed
+ *    over the fixed synthetic scene at several resolutions.
+ *  - Each benchmark is warmed up and repeated,
+ *    and the median and the 95th percentile of the times are reported.
+ *  - The results are written to the JSON file,
+ *    and compared with the results of the earlier run given by -b.
+ *  - The point cloud is registered to itself moved by the small known pose.
+ *  - The grid mesh is decimated, and the levels of detail are verified
+ *    to be manifold and to be independent of the winding of the triangles.
+ *  - The synthetic MPO is encoded and decoded in the big and the little endian,
+ *    and opened from the temporary file.
+ *  - The stereo images are reconstructed by the camera saved by the synthetic scene.
+ *  - The MPO files given as the arguments are also opened, read and decoded.
+ * 
+ * Usage:  rprj3d-bench [-s WIDTHxHEIGHT]... [-r REPS] [-w WARMUPS] [-o JSONFILE] [-b BASELINE] [MPOFILE...]
+ * 
+ * File:   bench.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:10 PM
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <regex>
+#include "Image.h"
+#include "Mpo.h"
+#include "StereoCamera.h"
+#include "Polygon.h"
+#include "Decimator.h"
+#include "Vertex.h"
+#include "OffscreenRenderer.h"
+#include "Registration.h"
+#include "MemoryStats.h"
+#include "SyntheticScene.h"
+
+using namespace std;
+
+// the result of the benchmark
+struct Result {
+    string name;            // name of the benchmark
+    string input;           // resolution or file name of the input
+    vector<double> msecs;   // time of each repetition in milliseconds
+    // get the percentile of the times by the nearest rank
+    double percentile(double p) const {
+        vector<double> sorted(msecs);
+        sort(sorted.begin(), sorted.end());
+        size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    };
+};
+
+/**
+ * Time the function
+ * The setup is run before each repetition and is not timed.
+ * @param name of the benchmark
+ * @param input of the benchmark
+ * @param number of the warm-ups
+ * @param number of the repetitions
+ * @param function to set up the repetition, or null
+ * @param function to be timed
+ * @return result
+ */
+static Result measure(const string& name, const string& input, int nWarmups, int nReps,
+        const function<void()>& setup, const function<void()>& run) {
+    Result res;
+    res.name = name;
+    res.input = input;
+    for (int i = 0; i < nWarmups + nReps; i++) {
+        if (setup) {
+            setup();
+        }
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        run();
+        double msec = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (i >= nWarmups) {
+            res.msecs.push_back(msec);
+        }
+    }
+    cout << setw(28) << left << name << setw(12) << input << right << fixed << setprecision(3)
+         << " median " << setw(10) << res.percentile(50.0) << " ms"
+         << ", p95 " << setw(10) << res.percentile(95.0) << " ms" << endl;
+    return res;
+}
+
+/**
+ * Run the benchmarks at the resolution
+ * @param size of the images
+ * @param number of the warm-ups
+ * @param number of the repetitions
+ * @param results to be appended
+ */
+static void benchResolution(const cv::Size& size, int nWarmups, int nReps, vector<Result>& results) {
+    ostringstream ss;
+    ss << size.width << "x" << size.height;
+    const string input = ss.str();
+    SyntheticScene scene(size);
+    vector<Image> imgs = scene.render();
+    // MPO
+    Mpo mpo;
+    for (int i = 0; i < 2; i++) {
+        const bool bigEnd = (i == 0);
+        const string endian(bigEnd ? "big" : "little");
+        vector<uchar> data;
+        results.push_back(measure("mpo.encode." + endian, input, nWarmups, nReps, nullptr, [&]() {
+            data = mpo.encode(imgs, "rprj3d", "Synthetic", bigEnd);
+        }));
+        results.push_back(measure("mpo.decode." + endian, input, nWarmups, nReps, nullptr, [&]() {
+            mpo.decode(data);
+        }));
+        // open the MPO file, which is read and decoded
+        const string mpoFn = string(P_tmpdir) + "/rprj3d-bench-" + input + "-" + endian + ".mpo";
+        mpo.write(mpoFn, data);
+        results.push_back(measure("mpo.open." + endian, input, nWarmups, nReps, nullptr, [&]() {
+            mpo.open(mpoFn);
+        }));
+        remove(mpoFn.c_str());
+    }
+    // disparity
+    Image disp;
+    const cv::Rect roi[] = { cv::Rect(cv::Point(), size), cv::Rect(cv::Point(), size) };
+    results.push_back(measure("disparity.bm", input, nWarmups, nReps, nullptr, [&]() {
+        disp.computeDisparityMapBM(imgs, roi);
+    }));
+    results.push_back(measure("disparity.sgbm", input, nWarmups, nReps, nullptr, [&]() {
+        disp.computeDisparityMapSGBM(imgs);
+    }));
+    // reprojection
+    StereoCamera sCam;
+    const cv::Mat qMat = scene.depthMapping();
+    vector<Vertex> vtcs;
+    results.push_back(measure("reproject", input, nWarmups, nReps, nullptr, [&]() {
+        sCam.reprojectDisparityTo3D(disp, imgs[0], qMat, vtcs);
+    }));
+    // reconstruction from the stereo images by the camera of the scene,
+    // whose images are rectified in place
+    const string camFn = string(P_tmpdir) + "/rprj3d-bench-" + input + ".yml";
+    scene.saveCamera(camFn);
+    StereoCamera sceneCam;
+    bool isOpened = sceneCam.open(camFn);
+    remove(camFn.c_str());
+    if (!isOpened) {
+        throw string("Could not read ") + camFn;
+    }
+    vector<Image> work;
+    results.push_back(measure("reproject.images", input, nWarmups, nReps, [&]() {
+        work = imgs;
+    }, [&]() {
+        sceneCam.reprojectImageTo3D(work);
+    }));
+    // polygon
+    shared_ptr<Polygon> ply;
+    results.push_back(measure("polygon.pointCloud", input, nWarmups, nReps, [&]() {
+        ply.reset(new Polygon);
+    }, [&]() {
+        ply->setPointCloud(vtcs);
+    }));
+    // the outliers are removed while the point cloud is set
+    results.push_back(measure("polygon.pointCloud.filtered", input, nWarmups, nReps, [&]() {
+        ply.reset(new Polygon);
+        ply->setOutlierFilter(Polygon::OutlierFilter::Statistical, Polygon::OUTLIERNBRS, Polygon::OUTLIERTHRESH);
+    }, [&]() {
+        ply->setPointCloud(vtcs);
+    }));
+    results.push_back(measure("polygon.normals", input, nWarmups, nReps, [&]() {
+        ply.reset(new Polygon);
+        ply->setPointCloud(vtcs);
+    }, [&]() {
+        ply->estimateNormals();
+    }));
+    results.push_back(measure("polygon.triangulate", input, nWarmups, nReps, [&]() {
+        ply.reset(new Polygon);
+        ply->setPointCloud(vtcs);
+        ply->estimateNormals();
+    }, [&]() {
+        ply->triangulateMesh();
+    }));
+    results.push_back(measure("polygon.normalizedVertices", input, nWarmups, nReps, nullptr, [&]() {
+        ply->normalizedVertices();
+    }));
+    results.push_back(measure("polygon.faceIndexes", input, nWarmups, nReps, nullptr, [&]() {
+        for (size_t i = 0; i < ply->nLevelsOfDetail(); i++) {
+            ply->faceIndexes(i);
+        }
+    }));
+    // registration
+    const vector<Vertex> target = ply->vertices();
+    vector<Vertex> source(target);
+    cv::Matx33d rot;
+    cv::Rodrigues(cv::Vec3d(0.0, 2.0 * M_PI / 180.0, 0.0), rot);
+    for_each(source.begin(), source.end(), [&](Vertex& vtx) {
+        const double* p = vtx.position3d();
+        const double* n = vtx.normal3d();
+        const cv::Vec3d pos = rot * cv::Vec3d(p[0], p[1], p[2]) + cv::Vec3d(3.0, -2.0, 4.0);
+        const cv::Vec3d nml = rot * cv::Vec3d(n[0], n[1], n[2]);
+        vtx.setPosition(pos[0], pos[1], pos[2]);
+        vtx.setNormal(nml[0], nml[1], nml[2]);
+    });
+    shared_ptr<Registration> reg;
+    results.push_back(measure("registration.grid", input, nWarmups, nReps, nullptr, [&]() {
+        reg.reset(new Registration(target));
+    }));
+    results.push_back(measure("registration.icp", input, nWarmups, nReps, nullptr, [&]() {
+        reg->align(source);
+    }));
+    // rendering
+    OffscreenRenderer renderer(size.width, size.height);
+    results.push_back(measure("render.setModel", input, nWarmups, nReps, nullptr, [&]() {
+        renderer.setModel(*ply);
+    }));
+    const float q[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    results.push_back(measure("render.offscreen", input, nWarmups, nReps, nullptr, [&]() {
+        renderer.render(q);
+    }));
+}
+
+/**
+ * Run the benchmark of the decimation of the grid mesh
+ * The grid is decimated also with the alternate triangles flipped,
+ * and the levels must have the same vertices, since the order of the collapses
+ * does not depend on the winding. Every edge must be shared by 2 triangles at most.
+ * @param number of the vertices in the row and the column
+ * @param number of the warm-ups
+ * @param number of the repetitions
+ * @param results to be appended
+ */
+static void benchDecimator(int nGrid, int nWarmups, int nReps, vector<Result>& results) {
+    ostringstream ss;
+    ss << nGrid << "x" << nGrid;
+    const string input = ss.str();
+    vector<float> pos;
+    for (int y = 0; y < nGrid; y++) {
+        for (int x = 0; x < nGrid; x++) {
+            pos.push_back((float)x);
+            pos.push_back((float)y);
+            pos.push_back((float)(0.3 * sin(x * 0.3) * cos(y * 0.2)));
+        }
+    }
+    vector<uint32_t> idxs, flipped;
+    for (int y = 0; y + 1 < nGrid; y++) {
+        for (int x = 0; x + 1 < nGrid; x++) {
+            const uint32_t a = y * nGrid + x, b = a + 1, c = a + nGrid, d = c + 1;
+            idxs.insert(idxs.end(), { a, b, d, a, d, c });
+            flipped.insert(flipped.end(), { a, b, d, a, c, d });
+        }
+    }
+    const size_t nTris = idxs.size() / 3;
+    const vector<size_t> nTargets = { nTris / 4, nTris / 16, nTris / 64 };
+    vector<shared_ptr<vector<uint32_t>>> lods;
+    results.push_back(measure("decimate.grid", input, nWarmups, nReps, nullptr, [&]() {
+        Decimator decimator(pos, idxs);
+        lods = decimator.decimate(nTargets);
+    }));
+    Decimator decimator(pos, flipped);
+    vector<shared_ptr<vector<uint32_t>>> flippedLods = decimator.decimate(nTargets);
+    auto vertices = [](const vector<uint32_t>& lod) {
+        vector<uint32_t> vtcs(lod);
+        sort(vtcs.begin(), vtcs.end());
+        vtcs.erase(unique(vtcs.begin(), vtcs.end()), vtcs.end());
+        return vtcs;
+    };
+    for (size_t i = 0; i < nTargets.size(); i++) {
+        const vector<uint32_t>& lod = *lods[i];
+        if (lod.size() / 3 > nTargets[i] || vertices(lod) != vertices(*flippedLods[i])) {
+            throw string("Invalid decimation of ") + input;
+        }
+        map<uint64_t, int> edges;
+        for (size_t j = 0; j < lod.size(); j += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint64_t a = lod[j+k], b = lod[j+(k+1)%3];
+                if (++edges[a < b ? (a << 32 | b) : (b << 32 | a)] > 2) {
+                    throw string("Non-manifold decimation of ") + input;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Run the benchmarks of the MPO file
+ * @param file name
+ * @param number of the warm-ups
+ * @param number of the repetitions
+ * @param results to be appended
+ */
+static void benchMpo(const string& fn, int nWarmups, int nReps, vector<Result>& results) {
+    Mpo mpo;
+    vector<uchar> data;
+    results.push_back(measure("mpo.open", fn, nWarmups, nReps, nullptr, [&]() {
+        mpo.open(fn);
+    }));
+    results.push_back(measure("mpo.read", fn, nWarmups, nReps, nullptr, [&]() {
+        mpo.read(fn, data);
+    }));
+    results.push_back(measure("mpo.decode", fn, nWarmups, nReps, nullptr, [&]() {
+        mpo.decode(data);
+    }));
+}
+
+/**
+ * Write the results in JSON
+ * Each result is written in a line to be compared by the line.
+ * @param output stream
+ * @param results
+ * @param number of the warm-ups
+ * @param number of the repetitions
+ */
+static void writeJson(ostream& os, const vector<Result>& results, int nWarmups, int nReps) {
+    auto escape = [](const string& str) {
+        string esc;
+        for_each(str.begin(), str.end(), [&](char c) {
+            if (c == '"' || c == '\\') {
+                esc += '\\';
+            }
+            esc += c;
+        });
+        return esc;
+    };
+    os << "{\"warmups\": " << nWarmups << ", \"repetitions\": " << nReps
+       << ", \"peak_rss\": " << MemoryStats::peakResidentBytes() << ", \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& res = results[i];
+        os << (i == 0 ? "\n" : ",\n") << fixed << setprecision(3)
+           << "{\"name\": \"" << escape(res.name) << "\", \"input\": \"" << escape(res.input) << "\""
+           << ", \"median_ms\": " << res.percentile(50.0) << ", \"p95_ms\": " << res.percentile(95.0)
+           << ", \"min_ms\": " << res.percentile(0.0) << "}";
+    }
+    os << "\n]}" << endl;
+}
+
+/**
+ * Compare the results with the results of the earlier run
+ * @param file name of the JSON of the earlier run
+ * @param results
+ */
+static void compare(const string& fn, const vector<Result>& results) {
+    ifstream file(fn.c_str());
+    if (!file) {
+        throw string("Could not read ") + fn;
+    }
+    // the medians of the earlier run by the name and the input
+    map<string, double> medians;
+    const regex re("\\{\"name\": \"([^\"]*)\", \"input\": \"([^\"]*)\", \"median_ms\": ([-0-9.eE+]+)");
+    string line;
+    while (getline(file, line)) {
+        smatch m;
+        if (regex_search(line, m, re)) {
+            medians[m[1].str() + " " + m[2].str()] = atof(m[3].str().c_str());
+        }
+    }
+    cout << "compared with " << fn << endl;
+    for_each(results.begin(), results.end(), [&](const Result& res) {
+        auto it = medians.find(res.name + " " + res.input);
+        if (it == medians.end() || it->second <= 0.0) {
+            return;
+        }
+        double ratio = res.percentile(50.0) / it->second;
+        cout << setw(28) << left << res.name << setw(12) << res.input << right << fixed << setprecision(3)
+             << " median " << setw(10) << it->second << " -> " << setw(10) << res.percentile(50.0) << " ms"
+             << " (" << setprecision(2) << ratio << "x)" << endl;
+    });
+}
+
+/*
+ * 
+ */
+int main(int argc, char** argv) {
+    vector<cv::Size> sizes;
+    int nReps = 5, nWarmups = 1;
+    string jsonFn("bench.json"), baselineFn;
+    vector<string> fns;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "-s" && i + 1 < argc) {
+            int width, height;
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                cerr << "Invalid size " << argv[i] << endl;
+                return 1;
+            }
+            sizes.push_back(cv::Size(width, height));
+        } else if (arg == "-r" && i + 1 < argc) {
+            nReps = max(1, atoi(argv[++i]));
+        } else if (arg == "-w" && i + 1 < argc) {
+            nWarmups = max(0, atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            jsonFn = argv[++i];
+        } else if (arg == "-b" && i + 1 < argc) {
+            baselineFn = argv[++i];
+        } else if (!arg.empty() && arg[0] == '-') {
+            cerr << "Usage: " << argv[0]
+                 << " [-s WIDTHxHEIGHT]... [-r REPS] [-w WARMUPS] [-o JSONFILE] [-b BASELINE] [MPOFILE...]" << endl;
+            return 1;
+        } else {
+            fns.push_back(arg);
+        }
+    }
+    if (sizes.empty()) {
+        sizes = { cv::Size(320, 240), cv::Size(640, 480), cv::Size(1280, 960) };
+    }
+    try {
+        vector<Result> results;
+        for_each(fns.begin(), fns.end(), [&](const string& fn) {
+            benchMpo(fn, nWarmups, nReps, results);
+        });
+        for_each(sizes.begin(), sizes.end(), [&](const cv::Size& size) {
+            benchResolution(size, nWarmups, nReps, results);
+        });
+        benchDecimator(200, nWarmups, nReps, results);
+        ofstream file(jsonFn.c_str());
+        if (!file) {
+            throw string("Could not write ") + jsonFn;
+        }
+        writeJson(file, results, nWarmups, nReps);
+        cout << "peak RSS: " << MemoryStats::format((double)MemoryStats::peakResidentBytes()) << endl;
+        if (!baselineFn.empty()) {
+            compare(baselineFn, results);
+        }
+    } catch (const string& msg) {
+        cerr << msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
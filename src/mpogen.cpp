@@ -0,0 +1,118 @@
+/* 
+ * The main routine of the synthetic MPO generator.
+ *  - The known textured 3D scene is rendered through the stereo camera,
+ *    and the left and the right images are encoded to the MPO file.
+ *  - The cameras are the calibrated stereo camera of the parameter file given by -p,
+ *    or the rectified cameras with the synthetic intrinsic parameters.
+ *  - The MP headers are in the big endian, or in the little endian by -l.
+ *  - The depth of the left image is written to the 16 bits PNG in 0.1 millimeters
+ *    as the ground truth, and the cameras are written to the parameter file.
+ * 
+ * Usage:  rprj3d-mpogen [-s WIDTHxHEIGHT] [-p PARAMFILE [-c WIDTHxHEIGHT]] [-l] [-q QUALITY]
+ *                       [-m "MAKE MODEL"] [-n FILES] [-o PREFIX]
+ * 
+ * File:   mpogen.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 11:40 PM
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include "Image.h"
+#include "Mpo.h"
+#include "StereoCamera.h"
+#include "SyntheticScene.h"
+
+using namespace std;
+
+/**
+ * Parse the size
+ * @param text such as "640x480"
+ * @param size
+ * @return parsed or not
+ */
+static bool parseSize(const char* text, cv::Size& size) {
+    return (sscanf(text, "%dx%d", &size.width, &size.height) == 2 && size.width > 0 && size.height > 0);
+}
+
+/*
+ * 
+ */
+int main(int argc, char** argv) {
+    cv::Size size(640, 480), calibSize(640, 480);
+    string paramFn, prefix("synthetic"), camera("rprj3d Synthetic");
+    bool bigEnd = true;
+    int quality = 95, nFiles = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "-s" && i + 1 < argc) {
+            if (!parseSize(argv[++i], size)) {
+                cerr << "Invalid size " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "-c" && i + 1 < argc) {
+            if (!parseSize(argv[++i], calibSize)) {
+                cerr << "Invalid size " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "-p" && i + 1 < argc) {
+            paramFn = argv[++i];
+        } else if (arg == "-l") {
+            bigEnd = false;
+        } else if (arg == "-q" && i + 1 < argc) {
+            quality = min(100, max(0, atoi(argv[++i])));
+        } else if (arg == "-m" && i + 1 < argc) {
+            camera = argv[++i];
+        } else if (arg == "-n" && i + 1 < argc) {
+            nFiles = max(1, atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [-s WIDTHxHEIGHT] [-p PARAMFILE [-c WIDTHxHEIGHT]] [-l] [-q QUALITY]"
+                 << " [-m \"MAKE MODEL\"] [-n FILES] [-o PREFIX]" << endl;
+            return 1;
+        }
+    }
+    // the maker and the model are separated by the first space
+    size_t sep = camera.find(' ');
+    string make = camera.substr(0, sep);
+    string model = (sep == string::npos ? string() : camera.substr(sep + 1));
+    try {
+        StereoCamera sCam;
+        if (!paramFn.empty() && !sCam.open(paramFn)) {
+            throw string("Could not open ") + paramFn;
+        }
+        for (int i = 0; i < nFiles; i++) {
+            shared_ptr<SyntheticScene> scene(paramFn.empty() ? new SyntheticScene(size, i)
+                                                             : new SyntheticScene(size, sCam, calibSize, i));
+            string name(prefix);
+            if (nFiles > 1) {
+                char num[16];
+                snprintf(num, sizeof(num), "_%03d", i);
+                name += num;
+            }
+            cv::Mat depth, depth16;
+            vector<Image> imgs = scene->render(&depth);
+            Mpo mpo;
+            mpo.write(name + ".mpo", mpo.encode(imgs, make, model, bigEnd, quality));
+            depth.convertTo(depth16, CV_16U, 10.0);
+            if (!cv::imwrite(name + "_depth.png", depth16)) {
+                throw string("Could not write ") + name + "_depth.png";
+            }
+            if (i == 0) {
+                scene->saveCamera(prefix + "_param.yml");
+            }
+            cout << name << ".mpo" << endl;
+        }
+    } catch (const string& msg) {
+        cerr << msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,279 @@
+/* 
+ * The main routine of the offscreen renderer.
+ *  - The 3D polygon is constructed from the MPO file without the display,
+ *    and rendered to the PNG thumbnail or the turntable frames.
+ *  - The time and the memory of each stage of the construction,
+ *    the time to render each frame and the peak memory are reported.
+ * 
+ *  - The MPO files are processed by the pipelined batch,
+ *    if 2 or more files are given, and the thumbnail of each file is rendered.
+ *  - The stereo camera is selected by the camera model of each file.
+ *  - The outliers of the point clouds in the batch are removed by -r.
+ *  - The depth maps of the files are fused into the volume by -f,
+ *    and the mesh extracted from the volume is rendered to the fused thumbnail.
+ *    Each capture is registered to the last fused one by ICP before it is fused,
+ *    and the capture that is not registered is skipped.
+ *  - The trace events of the stages are saved in the Chrome trace JSON
+ *    to the file given by -t, which is opened by Perfetto.
+ * 
+ * Usage:  rprj3d-render [-s WIDTHxHEIGHT] [-n FRAMES] [-l LOD] [-o PREFIX] [-t TRACEFILE] [-f] [-r] MPOFILE...
+ * 
+ * File:   render.cpp
+ * Author: munehiro
+ * 
+ * Created on October 18, 2026, 4:40 PM
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include "GraphicsModel.h"
+#include "Polygon.h"
+#include "OffscreenRenderer.h"
+#include "TsdfVolume.h"
+#include "Registration.h"
+#include "Vertex.h"
+#include "CalibrationStore.h"
+#include "StereoCamera.h"
+#include "Pipeline.h"
+#include "BatchProcessor.h"
+#include "FrameContext.h"
+#include "Trace.h"
+#include "MemoryStats.h"
+extern "C" {
+    #include "trackball.h"
+}
+
+using namespace std;
+
+/**
+ * Convert the pose between the point clouds to the pose between the cameras
+ * The point cloud is flipped in y and measured from the maximum range in z,
+ * and the conversion is its own inverse.
+ * @param pose between the point clouds
+ * @param maximum range of the z axis
+ * @return pose between the cameras
+ */
+static cv::Matx44d cameraPose(const cv::Matx44d& pose, double maxZ) {
+    const cv::Matx44d flip(1.0,  0.0,  0.0, 0.0,
+                           0.0, -1.0,  0.0, 0.0,
+                           0.0,  0.0, -1.0, maxZ,
+                           0.0,  0.0,  0.0, 1.0);
+    return flip * pose * flip;
+}
+
+/**
+ * Render the mesh extracted from the fused volume
+ * @param volume
+ * @param renderer
+ * @param level of detail
+ * @param prefix of the thumbnail file name
+ */
+static void renderFused(const TsdfVolume& vol, OffscreenRenderer& renderer, size_t lod, const string& prefix) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<Vertex> vtcs;
+    vector<uint32_t> idxs;
+    vol.extractMesh(vtcs, idxs);
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (idxs.empty()) {
+        throw string("Fused surface is empty");
+    }
+    Polygon ply;
+    ply.setMesh(vtcs, idxs);
+    float q[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    renderer.setModel(ply, lod);
+    renderer.render(q);
+    renderer.save(prefix + "_fused.png");
+    cout << "fused blocks: " << vol.nBlocks()
+         << ", volume: " << MemoryStats::format((double)vol.memoryBytes())
+         << ", vertices: " << vtcs.size() << ", triangles: " << idxs.size() / 3
+         << ", extract: " << sec * 1000.0 << " ms" << endl;
+}
+
+/**
+ * Register the capture to the last fused capture and fuse it into the volume
+ * The pose and the registration are updated only when the capture is fused.
+ * @param frame
+ * @param volume, which is created by the first frame
+ * @param registration to the last fused capture, or null
+ * @param pose of the last fused capture in the volume
+ */
+static void fuseFrame(Pipeline::Frame& frm, unique_ptr<TsdfVolume>& vol, unique_ptr<Registration>& reg,
+                      cv::Matx44d& pose) {
+    // the volume is clipped at the same maximum range as the point clouds
+    if (!vol) {
+        vol.reset(new TsdfVolume(TsdfVolume::VOXELSIZE, TsdfVolume::TRUNCATION, frm.sCam->maxRange()));
+    }
+    vector<Vertex> vtcs = frm.ply->vertices();
+    cv::Matx44d frmPose = pose;
+    if (reg) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Registration::Result res = reg->align(vtcs);
+        frmPose = pose * cameraPose(res.pose, frm.sCam->maxRange());
+        cout << ", registration "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms"
+             << " rmse " << res.rmse << " mm fitness " << res.fitness << " iterations " << res.nIters
+             << (res.isConverged ? "" : " not converged");
+    }
+    vol->integrate(frm.disp, frm.imgs[0], frm.qMat, frmPose);
+    pose = frmPose;
+    reg.reset(new Registration(vtcs));
+}
+
+/**
+ * Render the thumbnails of the MPO files by the pipelined batch
+ * @param file names
+ * @param renderer
+ * @param level of detail
+ * @param prefix of the thumbnail file names
+ * @param the depth maps are fused into the volume or not
+ * @param the outliers of the point clouds are removed or not
+ */
+static void renderBatch(const vector<string>& fns, OffscreenRenderer& renderer, size_t lod, const string& prefix,
+                        bool fuse, bool removeOutliers) {
+    // the stereo camera is selected by the camera model of each file
+    shared_ptr<CalibrationStore> store(new CalibrationStore);
+    if (!store->open()) {
+        throw string("Stereo camera is not calibrated");
+    }
+    BatchProcessor batch(Pipeline::reconstruction(store, removeOutliers));
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    size_t nDone = 0;
+    // the pose of each capture is chained by the registration to the last fused capture
+    unique_ptr<TsdfVolume> vol;
+    unique_ptr<Registration> reg;
+    cv::Matx44d pose = cv::Matx44d::eye();
+    batch.run(fns, [&](Pipeline::Frame& frm) {
+        if (!frm.error.empty()) {
+            cerr << frm.fn << ": " << frm.error << endl;
+            return;
+        }
+        float q[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        renderer.setModel(*frm.ply, lod);
+        renderer.render(q);
+        char name[32];
+        snprintf(name, sizeof(name), "_%03d.png", (int)frm.index);
+        renderer.save(prefix + name);
+        cout << frm.fn;
+        if (fuse) {
+            // the capture that is not registered or fused is skipped,
+            // and the next capture is registered to the last fused capture
+            try {
+                fuseFrame(frm, vol, reg, pose);
+            } catch (const string& msg) {
+                cout << ", not fused: " << msg;
+            } catch (const exception& ex) {
+                cout << ", not fused: " << ex.what();
+            }
+        }
+        for_each(frm.timings.begin(), frm.timings.end(), [](const Pipeline::Timing& tm) {
+            cout << ", " << tm.name << " " << tm.wallMsec << " ms " << MemoryStats::format((double)tm.keptBytes);
+        });
+        cout << endl;
+        nDone++;
+    });
+    double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "files: " << nDone << "/" << fns.size() << ", total: " << sec << " s"
+         << ", throughput: " << nDone / sec << " files/s"
+         << ", buffer allocations: " << FrameContext::nAllocations()
+         << ", unpooled allocations: " << FrameContext::nUnpooledAllocations()
+         << ", peak RSS: " << MemoryStats::format((double)MemoryStats::peakResidentBytes()) << endl;
+    if (vol && vol->nBlocks() > 0) {
+        renderFused(*vol, renderer, lod, prefix);
+    }
+}
+
+/*
+ * 
+ */
+int main(int argc, char** argv) {
+    int width = 320, height = 240, nFrms = 1;
+    size_t lod = 0;
+    string prefix("thumbnail"), traceFn;
+    bool fuse = false, removeOutliers = false;
+    vector<string> fns;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "-s" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2) {
+                cerr << "Invalid size " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "-n" && i + 1 < argc) {
+            nFrms = max(1, atoi(argv[++i]));
+        } else if (arg == "-l" && i + 1 < argc) {
+            lod = (size_t)max(0, atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (arg == "-t" && i + 1 < argc) {
+            traceFn = argv[++i];
+        } else if (arg == "-f") {
+            fuse = true;
+        } else if (arg == "-r") {
+            removeOutliers = true;
+        } else {
+            fns.push_back(arg);
+        }
+    }
+    if (fns.empty()) {
+        cerr << "Usage: " << argv[0]
+             << " [-s WIDTHxHEIGHT] [-n FRAMES] [-l LOD] [-o PREFIX] [-t TRACEFILE] [-f] [-r] MPOFILE..." << endl;
+        return 1;
+    }
+    if (!traceFn.empty()) {
+        Trace::enable(true);
+    }
+    try {
+        if (fns.size() > 1 || fuse) {
+            OffscreenRenderer renderer(width, height);
+            renderBatch(fns, renderer, lod, prefix, fuse, removeOutliers);
+            if (!traceFn.empty()) {
+                Trace::save(traceFn);
+            }
+            return 0;
+        }
+        GraphicsModel model;
+        model.open(fns[0]);
+        if (!model.polygon() || !model.polygon()->isValid()) {
+            throw string("Stereo camera is not calibrated");
+        }
+        // report the time and the memory of each stage of the construction
+        Pipeline::report(cout, model.stageTimings());
+        OffscreenRenderer renderer(width, height);
+        renderer.setModel(*model.polygon(), lod);
+        // rotate the polygon around the vertical axis
+        vector<double> times;
+        for (int i = 0; i < nFrms; i++) {
+            float axis[] = { 0.0f, 1.0f, 0.0f };
+            float q[4];
+            axis_to_quat(axis, (float)(2.0 * M_PI * i / nFrms), q);
+            renderer.render(q);
+            char name[32];
+            snprintf(name, sizeof(name), (nFrms > 1 ? "_%03d.png" : ".png"), i);
+            renderer.save(prefix + name);
+            times.push_back(renderer.frameTime());
+            cout << "frame " << i << ": " << renderer.frameTime() << " ms" << endl;
+        }
+        sort(times.begin(), times.end());
+        double sum = 0.0;
+        for_each(times.begin(), times.end(), [&](double t) { sum += t; });
+        cout << "frames: " << times.size()
+             << ", mean: " << sum / times.size() << " ms"
+             << ", median: " << times[times.size() / 2] << " ms"
+             << ", max: " << times.back() << " ms" << endl;
+        cout << "peak RSS: " << MemoryStats::format((double)MemoryStats::peakResidentBytes()) << endl;
+        if (!traceFn.empty()) {
+            Trace::save(traceFn);
+        }
+    } catch (const string& msg) {
+        cerr << msg << endl;
+        return 1;
+    }
+
+    return 0;
+}
+